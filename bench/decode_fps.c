@@ -0,0 +1,131 @@
+/** video decoding speed per thread count & threading type, the way the player opens its decoder
+ *  (refcounted frames from the frame pool). the first frames of the clip are decoded as fast as
+ *  possible for 1, 2, 4... threads up to the number of cores, with frame, slice & both threadings,
+ *  and the frames per second are printed. run it on 1080p & 4K clips.
+ *
+ *  usage: decode_fps $FILE [nb_frames (500)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include "libavutil/time.h"
+
+#include "frame_pool.h"
+
+static const struct{
+    const char *name;
+    int type;
+}thread_types[] = {
+    {"frame", FF_THREAD_FRAME},
+    {"slice", FF_THREAD_SLICE},
+    {"frame+slice", FF_THREAD_FRAME | FF_THREAD_SLICE},
+};
+
+//frames per second decoding the first 'nb_frames' frames of the video stream, <0 on error
+static double run(const char *filename, int threads, int thread_type, int nb_frames, int *width, int *height){
+    AVFormatContext *ic = NULL;
+    AVCodecContext *dec;
+    AVCodec *codec;
+    AVFrame *frame;
+    AVPacket pkt, flush_pkt;
+    FramePool *fp;
+    int64_t start;
+    int index, got, nb = 0, eof = 0;
+
+    if(avformat_open_input(&ic, filename, NULL, NULL) < 0 || avformat_find_stream_info(ic, NULL) < 0){
+        return -1;
+    }
+    if((index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0){
+        avformat_close_input(&ic);
+        return -1;
+    }
+    fp = frame_pool_create();
+    dec = avcodec_alloc_context3(codec);
+    avcodec_copy_context(dec, ic->streams[index]->codec);
+    dec->refcounted_frames = 1;
+    dec->opaque = fp;
+    dec->get_buffer2 = frame_pool_get_buffer2;
+    dec->thread_safe_callbacks = 1;
+    dec->thread_count = threads;
+    dec->thread_type = thread_type;
+    if(avcodec_open2(dec, codec, NULL) < 0){
+        av_free(dec);
+        frame_pool_destroy(&fp);
+        avformat_close_input(&ic);
+        return -1;
+    }
+    frame = av_frame_alloc();
+    av_init_packet(&flush_pkt);
+    flush_pkt.data = NULL;
+    flush_pkt.size = 0;
+
+    start = av_gettime();
+    while(nb < nb_frames){
+        if(!eof && av_read_frame(ic, &pkt) < 0){
+            eof = 1;
+        }
+        if(eof){
+            //drain the frames the threads still hold
+            avcodec_decode_video2(dec, frame, &got, &flush_pkt);
+            if(!got){
+                break;
+            }
+        }else{
+            got = 0;
+            if(pkt.stream_index == index){
+                avcodec_decode_video2(dec, frame, &got, &pkt);
+            }
+            av_packet_unref(&pkt);
+        }
+        if(got){
+            nb++;
+            av_frame_unref(frame);
+        }
+    }
+    start = av_gettime() - start;
+
+    *width = dec->width;
+    *height = dec->height;
+    av_frame_free(&frame);
+    avcodec_close(dec);
+    av_free(dec);
+    frame_pool_destroy(&fp);
+    avformat_close_input(&ic);
+    return start > 0 ? nb * 1e6 / start : 0.0;
+}
+
+int main(int argc, char *argv[]){
+    int nb_frames = argc > 2 ? atoi(argv[2]) : 500;
+    int cores = SDL_GetCPUCount();
+    int threads, i, width = 0, height = 0;
+    double fps, single = 0;
+
+    if(argc < 2){
+        fprintf(stderr, "usage: %s $FILE [nb_frames]\n", argv[0]);
+        return 1;
+    }
+    av_register_all();
+    av_log_set_level(AV_LOG_ERROR);
+
+    for(i=0; i<(int)(sizeof(thread_types) / sizeof(thread_types[0])); ++i){
+        for(threads=1; ; threads*=2){
+            threads = FFMIN(threads, cores);
+            if((fps = run(argv[1], threads, thread_types[i].type, nb_frames, &width, &height)) < 0){
+                fprintf(stderr, "could not decode %s.\n", argv[1]);
+                return 1;
+            }
+            if(threads == 1){
+                single = fps;
+            }
+            printf("{\"width\":%d, \"height\":%d, \"threading\":\"%s\", \"threads\":%d, \"fps\":%.1f, \"speedup\":%.2f}\n",
+                   width, height, thread_types[i].name, threads, fps, single > 0 ? fps / single : 0.0);
+            if(threads >= cores){
+                break;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+/** throughput of the ways open_input() can read a local file: the file protocol of libavformat
+ *  (plain read()), mmap_io, prefetch_io & uring_io. the file is read from start to end through
+ *  avio_read(), or demuxed with av_read_frame() given "demux", & MB/s are printed per mode.
+ *  on Linux the file is evicted from the page cache before every run (POSIX_FADV_DONTNEED) to
+ *  measure the storage, elsewhere use a file larger than the RAM or the second run is memcpy().
+ *
+ *  usage: io_read $FILE [demux] [nb_runs (3)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include <SDL.h>
+#include <libavformat/avformat.h>
+#include "libavutil/time.h"
+
+#include "input_io.h"
+
+#define READ_SIZE (64*1024)
+
+static const char *mode_names[] = {"file", "mmap", "prefetch", "uring"};
+
+static void drop_cache(const char *filename){
+#if defined(POSIX_FADV_DONTNEED)
+    int fd = open(filename, O_RDONLY);
+
+    if(fd >= 0){
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+//bytes read (or demuxed) through 'io_mode', <0 if the mode is unavailable
+static int64_t run(const char *filename, int io_mode, int demux){
+    static uint8_t buf[READ_SIZE];
+    AVFormatContext *ic = NULL;
+    AVIOContext *pb = NULL;
+    AVPacket pkt;
+    int64_t total = 0;
+    int n;
+
+    if(io_mode != IO_MODE_FILE){
+        if(!(pb = input_io_open(filename, io_mode, NULL))){
+            return -1;
+        }
+    }else if(!demux && avio_open(&pb, filename, AVIO_FLAG_READ) < 0){
+        return -1;
+    }
+
+    if(demux){
+        ic = avformat_alloc_context();
+        ic->pb = pb;
+        if(avformat_open_input(&ic, filename, NULL, NULL) < 0){
+            input_io_close(&pb, io_mode);
+            return -1;
+        }
+        while(av_read_frame(ic, &pkt) >= 0){
+            total += pkt.size;
+            av_packet_unref(&pkt);
+        }
+        avformat_close_input(&ic);
+    }else{
+        while((n = avio_read(pb, buf, READ_SIZE)) > 0){
+            total += n;
+        }
+    }
+
+    if(io_mode == IO_MODE_FILE){
+        if(!demux){
+            avio_closep(&pb);
+        }
+    }else{
+        input_io_dump_stats(pb, io_mode, stderr);
+        input_io_close(&pb, io_mode);
+    }
+    return total;
+}
+
+int main(int argc, char *argv[]){
+    int demux = argc > 2 && !strcmp(argv[2], "demux");
+    int nb_runs = argc > 3 ? atoi(argv[3]) : 3;
+    int64_t start, bytes, best;
+    double mbps;
+    int mode, i;
+
+    if(argc < 2){
+        fprintf(stderr, "usage: %s $FILE [demux] [nb_runs]\n", argv[0]);
+        return 1;
+    }
+    av_register_all();
+
+    for(mode=IO_MODE_FILE; mode<=IO_MODE_URING; ++mode){
+        best = 0;
+        bytes = 0;
+        for(i=0; i<nb_runs; ++i){
+            drop_cache(argv[1]);
+            start = av_gettime();
+            if((bytes = run(argv[1], mode, demux)) < 0){
+                break;
+            }
+            start = av_gettime() - start;
+            if(!best || start < best){
+                best = start;
+            }
+        }
+        if(bytes < 0){
+            printf("{\"mode\":\"%s\", \"unavailable\":1}\n", mode_names[mode]);
+            continue;
+        }
+        mbps = best ? bytes / (double)best : 0.0;
+        printf("{\"mode\":\"%s\", \"through\":\"%s\", \"bytes\":%"PRId64", \"best_us\":%"PRId64", \"MB_per_s\":%.1f}\n",
+               mode_names[mode], demux ? "av_read_frame" : "avio_read", bytes, best, mbps);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/** microbenchmark of packet_queue_get() against packet_queue_get_batch(): a producer thread puts
+ *  small refcounted packets as fast as it can while the consumer drains them, one at a time
+ *  or in batches, and the packets per second are printed for each batch size.
+ *
+ *  usage: queue_batch [nb_packets (2000000)] [packet_size (64)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+#include "libavutil/time.h"
+
+#include "packet_queue.h"
+
+#define MAX_BATCH 64
+
+static PacketQueue q;
+static int nb_packets = 2000000;
+static int packet_size = 64;
+
+static int producer(void *arg){
+    AVPacket pkt;
+    int i;
+
+    for(i=0; i<nb_packets; ++i){
+        if(av_new_packet(&pkt, packet_size) < 0){
+            break;
+        }
+        pkt.pts = i;
+        pkt.duration = 1;
+        if(packet_queue_put(&q, &pkt) < 0){
+            av_packet_unref(&pkt);
+            break;
+        }
+    }
+    return 0;
+}
+
+//packets per second drained 'batch' at a time, 1 goes through packet_queue_get()
+static double run(int batch){
+    AVPacket pkts[MAX_BATCH];
+    SDL_Thread *tid;
+    int64_t start;
+    int got = 0, nb, i;
+
+    packet_queue_init(&q);
+    start = av_gettime();
+    tid = SDL_CreateThread(producer, "producer", NULL);
+    while(got < nb_packets){
+        nb = batch == 1 ? packet_queue_get(&q, pkts, 1) : packet_queue_get_batch(&q, pkts, batch, 1);
+        if(nb < 0){
+            break;
+        }
+        for(i=0; i<nb; ++i){
+            av_packet_unref(&pkts[i]);
+        }
+        got += nb;
+    }
+    SDL_WaitThread(tid, NULL);
+    start = av_gettime() - start;
+    fprintf(stderr, "batch %d: ", batch);
+    packet_queue_dump_stats(&q, "bench", stderr);
+    packet_queue_destroy(&q);
+    return got * 1e6 / start;
+}
+
+int main(int argc, char *argv[]){
+    static const int batches[] = {1, 4, 16, MAX_BATCH};
+    double single = 0, rate;
+    int i;
+
+    if(argc > 1){
+        nb_packets = atoi(argv[1]);
+    }
+    if(argc > 2){
+        packet_size = atoi(argv[2]);
+    }
+    for(i=0; i<(int)(sizeof(batches) / sizeof(batches[0])); ++i){
+        rate = run(batches[i]);
+        if(batches[i] == 1){
+            single = rate;
+        }
+        printf("{\"batch\":%d, \"packets_per_s\":%.0f, \"speedup\":%.2f}\n", batches[i], rate, rate / single);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/** soak test of the generation flush of PacketQueue: a producer keeps putting refcounted packets,
+ *  a consumer keeps getting them & the main thread clears the queue (a seek) over & over.
+ *  prints the resident set size & the clear-to-first-packet latency every 1000 seeks.
+ *  fails (exit code 1) if RSS grows by more than the tolerance after the first 1000 seeks (warm-up),
+ *  stale packets are released by the consumer so it has to stay flat, or if the 99th percentile
+ *  of the latency is over its bound.
+ *
+ *  usage: queue_soak [nb_seeks (10000)] [packet_size (4096)] [max_rss_growth_kb (4096)] [max_p99_latency_us (20000)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <SDL.h>
+#include "libavutil/time.h"
+
+#include "packet_queue.h"
+
+extern int global_exit;
+
+static PacketQueue q;
+static int packet_size = 4096;
+static int64_t seek_time; //av_gettime() of the last clear, published by the serial bump
+static SDL_atomic_t landed; //seeks the consumer got a packet after
+static int64_t *latencies; //of every seek, in microseconds
+static int64_t max_latency, total_latency;
+
+static long rss_kbytes(void){
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))){
+        return -1;
+    }
+    return (long)(pmc.WorkingSetSize >> 10);
+#else
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if(!fp){
+        return -1;
+    }
+    if(fscanf(fp, "%ld %ld", &pages, &resident) != 2){
+        resident = -1;
+    }
+    fclose(fp);
+    return resident * (sysconf(_SC_PAGESIZE) >> 10);
+#endif
+}
+
+static int compare_latency(const void *a, const void *b){
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int producer(void *arg){
+    AVPacket pkt;
+    int64_t pts = 0;
+
+    while(!global_exit){
+        if(av_new_packet(&pkt, packet_size) < 0){
+            break;
+        }
+        pkt.pts = pts;
+        pkt.duration = 1;
+        pts++;
+        if(packet_queue_put(&q, &pkt) < 0){
+            av_packet_unref(&pkt); //cleared while blocked
+        }
+    }
+    return 0;
+}
+
+static int consumer(void *arg){
+    AVPacket pkt;
+    int serial = SDL_AtomicGet(&q.serial);
+    int64_t latency;
+
+    while(packet_queue_get(&q, &pkt, 1) > 0){
+        if(q.last_serial != serial){
+            serial = q.last_serial;
+            latency = av_gettime() - seek_time;
+            latencies[SDL_AtomicGet(&landed)] = latency;
+            total_latency += latency;
+            if(latency > max_latency){
+                max_latency = latency;
+            }
+            SDL_AtomicAdd(&landed, 1);
+        }
+        av_packet_unref(&pkt);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    SDL_Thread *producer_tid, *consumer_tid;
+    int nb_seeks = argc > 1 ? atoi(argv[1]) : 10000;
+    long max_rss_growth = argc > 3 ? atol(argv[3]) : 4096; //a full ring of 4 KB packets
+    int64_t max_p99 = argc > 4 ? atol(argv[4]) : 20000;
+    int i, failed = 0;
+    long rss_start, rss_warm = -1, rss_peak = -1, rss;
+    int64_t p99;
+
+    if(argc > 2){
+        packet_size = atoi(argv[2]);
+    }
+    latencies = av_malloc_array(FFMAX(nb_seeks, 1), sizeof(*latencies));
+    if(!latencies){
+        fprintf(stderr, "out of memory.\n");
+        return 1;
+    }
+    packet_queue_init(&q);
+    producer_tid = SDL_CreateThread(producer, "producer", NULL);
+    consumer_tid = SDL_CreateThread(consumer, "consumer", NULL);
+
+    SDL_Delay(100); //fill the ring once
+    rss_start = rss_kbytes();
+    printf("{\"seeks\":0, \"rss_kb\":%ld}\n", rss_start);
+
+    for(i=1; i<=nb_seeks; ++i){
+        seek_time = av_gettime();
+        packet_queue_clear(&q);
+        packet_queue_wakeup(&q); //the producer may sleep on a full ring
+        while(SDL_AtomicGet(&landed) < i){
+            SDL_Delay(0);
+        }
+        if(i % 1000 == 0){
+            rss = rss_kbytes();
+            if(rss_warm < 0){
+                rss_warm = rss;
+            }
+            if(rss > rss_peak){
+                rss_peak = rss;
+            }
+            printf("{\"seeks\":%d, \"rss_kb\":%ld, \"avg_latency_us\":%.1f, \"max_latency_us\":%"PRId64"}\n",
+                   i, rss, (double)total_latency / i, max_latency);
+        }
+    }
+
+    global_exit = 1;
+    packet_queue_wakeup(&q);
+    SDL_WaitThread(producer_tid, NULL);
+    SDL_WaitThread(consumer_tid, NULL);
+    packet_queue_destroy(&q);
+
+    //verdict: flat memory after the warm-up & bounded seek latency
+    if(rss_peak - rss_warm > max_rss_growth){
+        printf("RSS grew by %ld KB after the warm-up, %ld KB at most\n", rss_peak - rss_warm, max_rss_growth);
+        failed = 1;
+    }
+    qsort(latencies, nb_seeks, sizeof(*latencies), compare_latency);
+    p99 = nb_seeks > 0 ? latencies[(nb_seeks - 1) * 99 / 100] : 0;
+    if(p99 > max_p99){
+        printf("p99 seek latency of %"PRId64" us, %"PRId64" us at most\n", p99, max_p99);
+        failed = 1;
+    }
+    printf("{\"seeks\":%d, \"rss_growth_kb\":%ld, \"p99_latency_us\":%"PRId64"}\n%s\n",
+           nb_seeks, rss_peak - rss_warm, p99, failed ? "FAILED" : "passed");
+    av_free(latencies);
+    return failed;
+}
@@ -0,0 +1,145 @@
+/** seek-to-display latency as the player does it: seek_index_seek() to the keyframe before a random
+ *  target, avcodec_flush_buffers(), then decode & drop video frames until the one on screen at the
+ *  target. prints the GOP length of the clip & the latency of every seek summed up, run it on clips
+ *  encoded with different GOP lengths (e.g. x264 -g 12/60/250) to compare them.
+ *
+ *  usage: seek_latency $FILE [nb_seeks (100)] [decode_threads (0: as many as cores)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include "libavutil/time.h"
+
+#include "seek_index.h"
+
+static int cmp_int64(const void *a, const void *b){
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+//average distance between keyframes of 'st' in seconds, read from the start of the file
+static double gop_length(AVFormatContext *ic, AVStream *st){
+    AVPacket pkt;
+    int64_t first = AV_NOPTS_VALUE, last = AV_NOPTS_VALUE;
+    int nb_keys = 0, nb_packets = 0;
+
+    while(nb_packets < 3000 && av_read_frame(ic, &pkt) >= 0){
+        if(pkt.stream_index == st->index){
+            nb_packets++;
+            if((pkt.flags & AV_PKT_FLAG_KEY) && pkt.pts != AV_NOPTS_VALUE){
+                if(first == AV_NOPTS_VALUE){
+                    first = pkt.pts;
+                }
+                last = pkt.pts;
+                nb_keys++;
+            }
+        }
+        av_packet_unref(&pkt);
+    }
+    return nb_keys > 1 ? (last - first) * av_q2d(st->time_base) / (nb_keys - 1) : 0.0;
+}
+
+//decode from the current position until the frame covering 'target' (seconds), frames before are dropped
+static int decode_to(AVFormatContext *ic, AVStream *st, AVCodecContext *dec, AVFrame *frame, double target, int *nb_dropped){
+    AVPacket pkt;
+    int got, ret = -1;
+    double pts, duration = av_q2d(av_inv_q(st->avg_frame_rate.num ? st->avg_frame_rate : st->r_frame_rate));
+
+    while(ret < 0 && av_read_frame(ic, &pkt) >= 0){
+        if(pkt.stream_index == st->index){
+            avcodec_decode_video2(dec, frame, &got, &pkt);
+            if(got){
+                pts = av_frame_get_best_effort_timestamp(frame) * av_q2d(st->time_base);
+                if(pts + duration <= target){
+                    (*nb_dropped)++;
+                }else{
+                    ret = 0;
+                }
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(&pkt);
+    }
+    return ret;
+}
+
+int main(int argc, char *argv[]){
+    AVFormatContext *ic = NULL;
+    AVCodecContext *dec;
+    AVCodec *codec;
+    AVFrame *frame;
+    AVStream *st;
+    SeekIndex *si;
+    int64_t *latencies, start, total = 0;
+    double duration, target, offset, gop;
+    int nb_seeks = argc > 2 ? atoi(argv[2]) : 100;
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+    int index, i, nb = 0, nb_dropped = 0;
+
+    if(argc < 2){
+        fprintf(stderr, "usage: %s $FILE [nb_seeks] [decode_threads]\n", argv[0]);
+        return 1;
+    }
+    av_register_all();
+    if(avformat_open_input(&ic, argv[1], NULL, NULL) < 0 || avformat_find_stream_info(ic, NULL) < 0){
+        fprintf(stderr, "could not open %s.\n", argv[1]);
+        return 1;
+    }
+    if((index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0){
+        fprintf(stderr, "no video stream.\n");
+        return 1;
+    }
+    st = ic->streams[index];
+    dec = avcodec_alloc_context3(codec);
+    avcodec_copy_context(dec, st->codec);
+    dec->refcounted_frames = 1;
+    dec->thread_count = threads > 0 ? threads : SDL_GetCPUCount();
+    dec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if(avcodec_open2(dec, codec, NULL) < 0){
+        fprintf(stderr, "could not open the decoder.\n");
+        return 1;
+    }
+    frame = av_frame_alloc();
+    latencies = av_malloc_array(nb_seeks, sizeof(int64_t));
+
+    gop = gop_length(ic, st);
+    si = seek_index_open(ic, argv[1]);
+    duration = ic->duration != AV_NOPTS_VALUE ? (double)ic->duration / AV_TIME_BASE : 0.0;
+    offset = ic->start_time != AV_NOPTS_VALUE ? (double)ic->start_time / AV_TIME_BASE : 0.0;
+    srand(1);
+
+    for(i=0; i<nb_seeks; ++i){
+        seek_index_update(si, ic);
+        target = duration * rand() / ((double)RAND_MAX + 1);
+
+        start = av_gettime();
+        if(seek_index_seek(si, ic, (int64_t)(target * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD) < 0){
+            continue;
+        }
+        avcodec_flush_buffers(dec);
+        if(decode_to(ic, st, dec, frame, target + offset, &nb_dropped) < 0){
+            continue;
+        }
+        latencies[nb] = av_gettime() - start;
+        total += latencies[nb++];
+    }
+
+    if(nb){
+        qsort(latencies, nb, sizeof(int64_t), cmp_int64);
+        printf("{\"file\":\"%s\", \"width\":%d, \"height\":%d, \"gop_s\":%.2f, \"threads\":%d, \"seeks\":%d, "
+               "\"dropped_per_seek\":%.1f, \"avg_ms\":%.1f, \"median_ms\":%.1f, \"p95_ms\":%.1f, \"max_ms\":%.1f}\n",
+               argv[1], dec->width, dec->height, gop, dec->thread_count, nb, (double)nb_dropped / nb,
+               total / 1000.0 / nb, latencies[nb / 2] / 1000.0, latencies[nb * 95 / 100] / 1000.0, latencies[nb - 1] / 1000.0);
+    }
+
+    seek_index_close(&si);
+    av_free(latencies);
+    av_frame_free(&frame);
+    avcodec_close(dec);
+    av_free(dec);
+    avformat_close_input(&ic);
+    return 0;
+}
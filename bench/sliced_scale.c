@@ -0,0 +1,117 @@
+/** conversion time of one sws_scale() over the picture against sliced_scale_frame() with 2, 4...
+ *  threads, on a synthetic picture (4K by default) of a few formats with vertically halved chroma,
+ *  the ones sliced_scale can split. every sliced output is compared with the single sws_scale() one,
+ *  they must be identical.
+ *
+ *  usage: sliced_scale [width (3840)] [height (2160)] [nb_frames (20)] [max_threads (cores, at least 4)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+#include <libswscale/swscale.h>
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#include "sliced_scale.h"
+
+static const char *formats[] = {"nv12", "yuv420p10le", "nv21"};
+
+static AVFrame *picture(enum AVPixelFormat format, int w, int h){
+    AVFrame *frame = av_frame_alloc();
+
+    frame->format = format;
+    frame->width = w;
+    frame->height = h;
+    if(av_frame_get_buffer(frame, 32) < 0){
+        av_frame_free(&frame);
+        return NULL;
+    }
+    return frame;
+}
+
+//same picture content whatever the linesizes, the padding is left out of the comparison
+static int same_picture(AVFrame *a, AVFrame *b){
+    int p, y, w, h;
+
+    for(p=0; p<3; ++p){
+        w = p ? (a->width + 1) >> 1 : a->width;
+        h = p ? (a->height + 1) >> 1 : a->height;
+        for(y=0; y<h; ++y){
+            if(memcmp(a->data[p] + y * a->linesize[p], b->data[p] + y * b->linesize[p], w)){
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]){
+    int w = argc > 1 ? atoi(argv[1]) : 3840;
+    int h = argc > 2 ? atoi(argv[2]) : 2160;
+    int nb_frames = argc > 3 ? atoi(argv[3]) : 20;
+    int max_threads = argc > 4 ? atoi(argv[4]) : FFMAX(SDL_GetCPUCount(), 4);
+    enum AVPixelFormat format;
+    struct SwsContext *sws_ctx;
+    SlicedScale *ss;
+    AVFrame *src, *ref, *dst;
+    int64_t start, single;
+    int f, p, i, threads, failed = 0;
+    unsigned seed = 1;
+
+    for(f=0; f<(int)(sizeof(formats) / sizeof(formats[0])); ++f){
+        format = av_get_pix_fmt(formats[f]);
+        src = picture(format, w, h);
+        ref = picture(AV_PIX_FMT_YUV420P, w, h);
+        dst = picture(AV_PIX_FMT_YUV420P, w, h);
+        if(!src || !ref || !dst){
+            fprintf(stderr, "out of memory.\n");
+            return 1;
+        }
+        //noise, 10 bits samples kept in range
+        for(p=0; p<4 && src->buf[p]; ++p){
+            for(i=0; i<src->buf[p]->size; ++i){
+                seed = seed * 1103515245 + 12345;
+                src->buf[p]->data[i] = (seed >> 16) & ((format == av_get_pix_fmt("yuv420p10le") && (i & 1)) ? 0x03 : 0xFF);
+            }
+        }
+
+        sws_ctx = sws_getContext(w, h, format, w, h, AV_PIX_FMT_YUV420P, SWS_BICUBIC, NULL, NULL, NULL);
+        start = av_gettime();
+        for(i=0; i<nb_frames; ++i){
+            sws_scale(sws_ctx, (const uint8_t * const *)src->data, src->linesize, 0, h, ref->data, ref->linesize);
+        }
+        single = (av_gettime() - start) / nb_frames;
+        sws_freeContext(sws_ctx);
+        printf("{\"format\":\"%s\", \"width\":%d, \"height\":%d, \"threads\":1, \"us_per_frame\":%"PRId64"}\n",
+               formats[f], w, h, single);
+
+        for(threads=2; threads<=max_threads; threads*=2){
+            ss = sliced_scale_create(threads);
+            memset(dst->buf[0]->data, 0, dst->buf[0]->size);
+            start = av_gettime();
+            for(i=0; i<nb_frames; ++i){
+                if(sliced_scale_frame(ss, src, dst) < 0){
+                    break;
+                }
+            }
+            start = i ? (av_gettime() - start) / i : 0;
+            sliced_scale_destroy(&ss);
+            if(i < nb_frames){
+                printf("{\"format\":\"%s\", \"threads\":%d, \"sliced\":0}\n", formats[f], threads);
+                continue;
+            }
+            if(!same_picture(ref, dst)){
+                failed = 1;
+            }
+            printf("{\"format\":\"%s\", \"width\":%d, \"height\":%d, \"threads\":%d, \"us_per_frame\":%"PRId64", "
+                   "\"speedup\":%.2f, \"identical\":%d}\n",
+                   formats[f], w, h, threads, start, start ? (double)single / start : 0.0, same_picture(ref, dst));
+        }
+        av_frame_free(&src);
+        av_frame_free(&ref);
+        av_frame_free(&dst);
+    }
+    return failed;
+}
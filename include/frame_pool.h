@@ -0,0 +1,38 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stdio.h>
+#include <libavcodec/avcodec.h>
+
+#define FRAME_POOL_ALIGN 64 //alignment of the planes & their linesizes
+#define FRAME_POOL_NB_CLASSES 16 //plane sizes pooled at most, others are allocated each time
+#define FRAME_POOL_LARGE_ALLOC (256*1024) //allocations counted as large
+//#define FRAME_POOL_HUGEPAGES //back planes of 2MB & more with transparent huge pages (Linux)
+
+typedef struct FramePoolStats{
+    int nb_gets; //planes handed out
+    int nb_allocs; //buffers allocated, they are recycled afterwards
+    int nb_large_allocs; //... of FRAME_POOL_LARGE_ALLOC bytes & more, flat in steady state
+    int64_t alloc_bytes;
+    int nb_fallbacks; //frames left to avcodec_default_get_buffer2()
+}FramePoolStats;
+
+/** planes of decoded frames & pictures, recycled through one AVBufferPool per size class */
+typedef struct FramePool FramePool;
+
+FramePool *frame_pool_create(void);
+
+/** drop the pool, buffers still referenced are freed when released */
+void frame_pool_destroy(FramePool **fp);
+
+/** get_buffer2() of a video decoder whose 'opaque' is the FramePool.
+ *  decoders without AV_CODEC_CAP_DR1 & exotic formats go to avcodec_default_get_buffer2() */
+int frame_pool_get_buffer2(AVCodecContext *s, AVFrame *frame, int flags);
+
+/** allocate the planes of 'frame' (format, width & height set) from the pool */
+int frame_pool_get_frame(FramePool *fp, AVFrame *frame);
+
+/** print the counters as one line of JSON */
+void frame_pool_dump_stats(FramePool *fp, FILE *fp_out);
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,38 @@
+#ifndef INPUT_IO_H
+#define INPUT_IO_H
+
+#include <stdio.h>
+#include <libavformat/avformat.h>
+
+//how open_input() reads a local file
+enum{
+    IO_MODE_FILE, //default file protocol of libavformat
+    IO_MODE_MMAP, //memory mapping, see mmap_io.h
+    IO_MODE_PREFETCH, //I/O thread reading ahead into a ring, see prefetch_io.h
+    IO_MODE_URING, //reads kept in flight through io_uring (Linux only), see uring_io.h
+};
+//mapping is opt-in: a large file may not fit the address space of a 32-bit build
+#define IO_MODE IO_MODE_FILE
+
+/** the path of a local file ("file:xxx" or no protocol at all), NULL for other urls */
+const char *input_io_local_path(const char *filename);
+
+/** identity of a local file for the sidecar caches: its size & modification time.
+ *  returns 0 on success, <0 if 'filename' is not a regular local file */
+int input_io_file_identity(const char *filename, int64_t *size, int64_t *mtime);
+
+/** open a custom AVIOContext for 'filename' as 'io_mode' says, blocking reads give up
+ *  with AVERROR_EXIT as soon as 'int_cb' (may be NULL) says so.
+ *  returns NULL if the default protocol should be used instead */
+AVIOContext *input_io_open(const char *filename, int io_mode, const AVIOInterruptCB *int_cb);
+
+/** whether 'int_cb' (may be NULL) asks blocking I/O to give up */
+int input_io_interrupted(const AVIOInterruptCB *int_cb);
+
+/** free an AVIOContext opened by input_io_open() */
+void input_io_close(AVIOContext **pb, int io_mode);
+
+/** print the counters of an AVIOContext opened by input_io_open() as one line of JSON */
+void input_io_dump_stats(AVIOContext *pb, int io_mode, FILE *fp);
+
+#endif // INPUT_IO_H
@@ -0,0 +1,17 @@
+#ifndef MMAP_IO_H
+#define MMAP_IO_H
+
+#include <libavformat/avformat.h>
+
+#define MMAP_IO_BUFFER_SIZE (64*1024) //size of the AVIOContext buffer
+#define MMAP_IO_READAHEAD (4*1024*1024) //bytes ahead of the reading position hinted to the kernel
+
+/** map a local file into memory & serve reads/seeks of an AVIOContext from the mapping.
+ *  returns NULL if 'filename' is not a local file or can't be mapped,
+ *  in which case the default file protocol should be used */
+AVIOContext *mmap_io_open(const char *filename);
+
+/** unmap the file & free the AVIOContext */
+void mmap_io_close(AVIOContext **pb);
+
+#endif // MMAP_IO_H
@@ -5,15 +5,64 @@
 #include <libavformat/avformat.h>
 #include <SDL.h>
 
-#define MAX_AUDIOQ_SIZE (5*16*1024)
-#define MAX_VIDEOQ_SIZE (5*256*1024)
+//buffered time per stream (in seconds), whatever the bitrate is
+#define MIN_QUEUE_DURATION 1.0 //keep reading while a stream has less than this
+#define MAX_QUEUE_DURATION 5.0 //stop reading once a stream has more than this
+#define MAX_QUEUES_SIZE (64*1024*1024) //backstop: memory ceiling of all queues in bytes
 
+#define PACKET_QUEUE_CAPACITY 1024 //number of slots in the ring, MUST be a power of 2
+
+/** counters of a queue, written by the producer or the consumer only & read without locking,
+ *  so a snapshot is approximate. times are in microseconds */
+typedef struct PacketQueueStats{
+    int nb_packets; //current number of elements (snapshot only)
+    int size; //current total size (snapshot only)
+    int duration; //current total duration, in stream time_base (snapshot only)
+    int max_nb_packets; //high-water mark of nb_packets (producer)
+    int max_size; //high-water mark of size (producer)
+    int max_duration; //high-water mark of duration (producer)
+    int nb_empty_waits; //times the consumer blocked on an empty queue (consumer)
+    int64_t wait_time; //time the consumer spent blocked in total (consumer)
+    int64_t max_wait_time; //longest single blocking of the consumer (consumer)
+    int nb_full_waits; //times the producer blocked on a full ring or the size cap (producer)
+    int64_t full_wait_time; //time the producer spent blocked in total (producer)
+
+    //the slots are a slab preallocated by packet_queue_init() and recycled forever,
+    //so steady-state playback of refcounted packets allocates nothing in the queue
+    int nb_allocs; //allocations made by the queue: the slab, then a buffer per packet copied (producer)
+    int nb_node_reuses; //slots recycled by packet_queue_put() (producer)
+
+    //packets are moved through the queue by reference, only non-refcounted input is copied
+    int64_t nb_copied_bytes; //payload bytes copied by packet_queue_put() (producer)
+}PacketQueueStats;
+
+typedef struct PacketQueueSlot{
+    AVPacket pkt;
+    int serial; //generation of the queue when the packet was put
+    int duration; //duration accounted for the packet, in stream time_base
+}PacketQueueSlot;
+
+/** a bounded single-producer/single-consumer ring of AVPackets.
+ *  the parse thread is the only producer (advancing head) and each decoder is the only
+ *  consumer (advancing tail), the mutex & conds are touched only when the ring is empty/full. */
 typedef struct PacketQueue{
-    AVPacketList *first_pkt, *last_pkt;
-    int nb_packets; //number of all elements
-    int size; //total size of all elements
+    PacketQueueSlot *slots; //ring slots, slots[index & (PACKET_QUEUE_CAPACITY-1)]
+    SDL_atomic_t head; //next slot to write, free-running
+    SDL_atomic_t tail; //next slot to read, free-running
+    SDL_atomic_t size; //total size of all elements
+    SDL_atomic_t duration; //total duration of all elements, in stream time_base
+    int64_t last_pts; //pts of the last packet put, to estimate missing durations (producer only)
+    SDL_atomic_t serial; //generation, bumped on every flush
+    int last_serial; //generation of the last packet got (consumer only)
+    SDL_atomic_t get_waiting; //consumer is sleeping on 'cond'
+    SDL_atomic_t put_waiting; //producer is sleeping on 'space_cond'
+    int space_low; //producer wants 'space_cond' once size drops to this watermark
+    int duration_low; //... or once duration drops to this watermark
     SDL_mutex *mutex;
-    SDL_cond *cond;
+    SDL_cond *cond; //signalled when the ring is no longer empty
+    SDL_cond *space_cond; //signalled when the ring is no longer full
+
+    PacketQueueStats stats;
 }PacketQueue;
 
 //int quit_get_from_queue; //stop getting AVPacket from the queue
@@ -21,13 +70,41 @@ typedef struct PacketQueue{
 /** initialize a queue */
 void packet_queue_init(PacketQueue *q);
 
-/** clear a queue */
+/** free the slots & sync facilities of a queue, together with the packets left in it */
+void packet_queue_destroy(PacketQueue *q);
+
+/** flush a queue in O(1) by starting a new generation,
+ *  stale packets are released lazily by the consumer */
 void packet_queue_clear(PacketQueue *q);
 
-/** append "one" AVPacket to the end of the queue */
+/** append "one" AVPacket to the end of the queue, blocking while the ring is full.
+ *  the reference held by 'pkt' is moved into the queue & 'pkt' is reset on success.
+ *  returns -1 if the queue was cleared or quitting while blocked, 'pkt' is left untouched */
 int packet_queue_put(PacketQueue *q, AVPacket *pkt);
 
-/** get "one" AVPacket from the queue in blocking/non-blocking manner*/
+/** get "one" AVPacket of the current generation from the queue in blocking/non-blocking manner,
+ *  the reference is moved into 'pkt', which should be released by av_packet_unref() */
 int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block);
 
+/** get up to 'max' AVPackets of the current generation from the queue at once.
+ *  returns the number of packets got, 0 if non-blocking & empty, or -1 when quitting */
+int packet_queue_get_batch(PacketQueue *q, AVPacket *pkts, int max, int block);
+
+/** block the producer until consumers drain the queue down to 'low_size' bytes
+ *  or 'low_duration' (in stream time_base), pass -1 to ignore either, or until the queue is cleared.
+ *  returns 0, or -1 when quitting */
+int packet_queue_wait_space(PacketQueue *q, int low_size, int low_duration);
+
+/** number of all elements */
+int packet_queue_nb_packets(PacketQueue *q);
+
+/** take a snapshot of the counters of a queue */
+void packet_queue_get_stats(PacketQueue *q, PacketQueueStats *st);
+
+/** print the counters of a queue as one line of JSON */
+void packet_queue_dump_stats(PacketQueue *q, const char *name, FILE *fp);
+
+/** wake up threads blocked on the queue, so that they notice global_exit/global_exit_parse */
+void packet_queue_wakeup(PacketQueue *q);
+
 #endif // _PACKET_QUEUE_H
@@ -2,7 +2,28 @@
 #define PARSE_H
 
 #include <stdint.h>
+#include "player.h"
 
 int parse_thread(void *arg);
 
+/** wake up the parse thread & everyone blocked on the packet queues, e.g. when quitting */
+void parse_thread_wakeup(VideoState *is);
+
+/** ask every thread to quit (global_exit/global_exit_parse) & wake them all up */
+void parse_thread_quit(VideoState *is);
+
+/** switch to trick play at 'speed' (0 back to normal playback, <0 to rewind) from 'pos'
+ *  (AV_TIME_BASE, from the start of the file): the audio is muted & only keyframes are shown */
+void parse_thread_trick_play(VideoState *is, int speed, int64_t pos);
+
+/** called by the decoders on the first frame at the seek target, prints the seek latency once */
+void parse_seek_landed(VideoState *is);
+
+/** interrupt_callback of is->pFormatCtx: blocking demuxer I/O gives up when quitting or seeking */
+int parse_interrupt_cb(void *opaque);
+
+/** ask the running parse thread to seek to 'pos' (AV_TIME_BASE, from the start of the file).
+ *  returns at once: the queues are flushed now, the seek is done before the next read */
+void parse_thread_seek(VideoState *is, int64_t pos);
+
 #endif // PARSE_H
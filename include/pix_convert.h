@@ -0,0 +1,24 @@
+#ifndef PIX_CONVERT_H
+#define PIX_CONVERT_H
+
+#include <libavutil/frame.h>
+
+//instruction sets of the kernels
+#define PIX_CONVERT_SSE2 0x01
+#define PIX_CONVERT_AVX2 0x02
+
+/** converts 'src' into the YUV420P 'dst' of the same size.
+ *  returns 0, AVERROR(ENOSYS) for the sizes it does not cover & sws_scale() has to convert */
+typedef int (*PixConvertFunc)(const AVFrame *src, AVFrame *dst);
+
+/** instruction sets of the running CPU (CPUID, XGETBV for the AVX state) */
+int pix_convert_cpu_flags(void);
+
+/** kernel converting pictures of 'format' to YUV420P with the best of 'cpu_flags',
+ *  NULL when there is none & sws_scale() does it. 'name' gets the kernel chosen.
+ *  each gives exactly what a same-size sws_scale() does: the NV12 chroma shuffle & the dithered
+ *  shift of YUV420P10 whatever the flags, the average of the YUV422P chroma rows as SWS_AREA
+ *  (even heights of 4 rows & more only) */
+PixConvertFunc pix_convert_get(int format, int cpu_flags, const char **name);
+
+#endif // PIX_CONVERT_H
@@ -9,6 +9,11 @@
 #define MAX_AUDIO_FRAME_SIZE 192000
 
 #include <packet_queue.h>
+#include <seek_index.h>
+#include <startup.h>
+#include <frame_pool.h>
+#include <sliced_scale.h>
+#include <pix_convert.h>
 
 //ffmpeg
 #define FF_REFRESH_EVENT (SDL_USEREVENT)
@@ -20,21 +25,71 @@
 #define AV_SYNC_THRESHOLD 0.01
 #define AV_NOSYNC_THRESHOLD 10.0
 
-//note: allocated once
+//dump the counters of audioq/videoq to stderr periodically, as JSON lines
+//#define SHOW_QUEUE_STATS
+#define QUEUE_STATS_INTERVAL 1000 //ms
+
+//trick play: speeds of 2x ... 32x both ways, keyframes only
+#define TRICK_PLAY_MAX_SPEED 32
+#define TRICK_PLAY_FPS 15.0 //keyframes shown per second at most, the demuxer jumps over the others
+#define TRICK_PLAY_QUEUE_SIZE 4 //keyframes queued ahead of the video decoder at most
+#define TRICK_PLAY_MAX_MISS 8 //jumps landing on a keyframe shown already before giving up (start/end of file)
+
+//threads of the video decoder, 0 for as many as cores
+#define VIDEO_DECODE_THREADS 0
+//FF_THREAD_FRAME, FF_THREAD_SLICE or both; the decoder takes what it supports
+#define VIDEO_DECODE_THREAD_TYPE (FF_THREAD_FRAME | FF_THREAD_SLICE)
+//threads converting bands of a picture to YUV420P, 0 for as many as cores, 1 for sws_scale() alone
+#define VIDEO_SCALE_THREADS 0
+
+//late frames: dropped before conversion when behind the audio clock by more than the threshold,
+//after so many drops in a row the decoder skips non-reference frames, then the loop filter too
+#define VIDEO_LATE_THRESHOLD 0.1 //seconds
+#define VIDEO_LATE_ESCALATE 8
+#define VIDEO_LATE_RECOVER 50 //frames in time in a row to step the skipping back down
+#define VIDEO_LATE_MAX_LEVEL 2
+
+//pictures decoded ahead of the display at most
+#define VIDEO_PICTURE_QUEUE_SIZE 4
+
+//packets taken from audioq/videoq with a single packet_queue_get_batch()
+#define AUDIO_PKT_BATCH 16
+#define VIDEO_PKT_BATCH 8
+
+//note: pFrameYUV is allocated on first use & again when the decoder changes the frame size
 typedef struct VideoPicture{
     //SDL_Overlay *bmp; //SDL2 counterpart ???
     //int width, height;
     AVFrame *pFrameYUV;
-    int width, height;
+    AVFrame *frame; //reference to a decoded YUV420P frame, shown as is without conversion
+    int direct; //show 'frame' rather than 'pFrameYUV'
+    int width, height; //of the picture, the texture follows it
     int allocated;
     double pts;
+    int serial; //generation of videoq the picture was decoded from
 }VideoPicture;
 
 typedef struct VideoState{
     AVFormatContext *pFormatCtx;
+    AVIOContext *io_ctx; //custom I/O serving pFormatCtx, NULL for the default protocol
+    int io_mode; //IO_MODE_xxx, see input_io.h
+    SeekIndex *seek_index; //keyframe index for the files indexed by us, NULL otherwise
     struct SwsContext *sws_ctx;
 
-    uint32_t seek_pos_sec; //seek position in seconds
+    //seek request, posted by parse_thread_seek() & carried out by the parse thread between two reads
+    SDL_atomic_t seek_req;
+    int64_t seek_pos; //AV_TIME_BASE, from the start of the file (under parse_mutex)
+    int64_t seek_time; //av_gettime() of the request, for the latency
+    int64_t quit_time; //av_gettime() of parse_thread_quit(), for the shutdown latency
+    double seek_target; //pts (seconds) of the last seek, the decoders drop what comes before it
+    SDL_atomic_t seek_landed; //a frame at the seek target came out of a decoder
+
+    SDL_atomic_t trick_speed; //0 for normal playback, +/-2 ... TRICK_PLAY_MAX_SPEED for keyframe scan
+    double trick_last; //pts of the last keyframe queued by the parse thread in trick play
+    int trick_miss; //jumps in a row which found no new keyframe
+
+    SDL_mutex *parse_mutex;
+    SDL_cond *parse_cond; //the parse thread idles on it at the end of the stream
 
     /** ************** audio related ************** */
     int audio_stream_index;
@@ -47,10 +102,16 @@ typedef struct VideoState{
     //    audio_pktһûȫaudio packetaudio_pkt_data[0, ... , audio_pkt_size-1]еʣಿ
 
     //(1) packets are read from audio stream, appending to the audioq.
-    PacketQueue audioq; //list of AVPacketList(a AVPacket Wrapper)
+    PacketQueue audioq; //SPSC ring of PacketQueueSlot, put by the parse thread & got by the audio callback
 
     //(2) a single packet is picked out, waiting for decoding into one or more frames.
+    //    packets are taken from audioq in batches, audio_pkts[audio_pkts_index, ... , audio_pkts_nb-1] are left
+    AVPacket audio_pkts[AUDIO_PKT_BATCH];
+    int audio_pkts_index;
+    int audio_pkts_nb;
     AVPacket *audio_pkt_ptr;
+    int audio_serial; //generation of audioq being decoded, a new one means a seek
+    double audio_drop_until; //decode & drop the audio up to this pts after a seek, <0 when done
     //1 "audio packet" may be decoded into multiple "audio frames", that is,
     //audio_pkt_data[0, ... , audio_pkt_size-1] is the remaining part waiting for decoding
     uint8_t *audio_pkt_data;
@@ -72,27 +133,50 @@ typedef struct VideoState{
     int video_stream_index;
     AVStream *video_st;
     AVCodecContext *video_ctx;
+    FramePool *frame_pool; //planes of the decoded frames & converted pictures
+    int decode_threads; //VIDEO_DECODE_THREADS
+    int decode_thread_type; //VIDEO_DECODE_THREAD_TYPE
+    PixConvertFunc pix_convert; //kernel for pictures of pix_convert_format, NULL: swscale
+    int pix_convert_format;
+    SlicedScale *sliced_scale; //parallel conversion, NULL: sws_ctx alone
+    int scale_threads; //VIDEO_SCALE_THREADS
 
     double video_clock;
     double frame_timer; //predicted pts of the next video frame.
     double frame_last_pts; //(actual) pts of the last video frame.
     double frame_last_delay; //last delay of two adjacent video frames.
+    int frame_serial; //generation of videoq on display, the timer restarts on a new one
 
     //(1)video packet queue
-    PacketQueue videoq;
+    PacketQueue videoq; //SPSC ring of PacketQueueSlot, put by the parse thread & got by video_thread
 
     //(2)AVPacket allocated within "video decoding thread"
 
     //(3)AVFrame allocated within "video decoding thread"
     //AVFrame
     //  --(YUV conversion)--> VideoPicture
-    //  --(copy into back buffer)--> pictq[0]
-    VideoPicture pictq;
-    int pictq_size;
+    //  --(copy into back buffer)--> pictq[pictq_windex]
+    //the display shows pictq[pictq_rindex], pictq_size pictures are waiting in the ring
+    VideoPicture pictq[VIDEO_PICTURE_QUEUE_SIZE];
+    int pictq_size, pictq_rindex, pictq_windex;
+    int pictq_max_size; //high-water mark
+    int pictq_nb_full_waits; //times the decoder waited for the display
+    int pictq_nb_empty; //refreshes finding no picture ready
+    int pictq_nb_converted; //pictures converted, by a kernel or swscale
+    int pictq_nb_direct; //decoded frames shown as is
+    int64_t pictq_convert_time; //microseconds spent converting in total
+
+    int late_level; //0, 1 skip_frame = AVDISCARD_NONREF, 2 skip_loop_filter as well
+    int late_in_row; //frames dropped in a row
+    int in_time_in_row; //frames in time in a row
+    int nb_late_dropped; //late frames dropped before conversion
+    int nb_late_skipped; //frames the decoder skipped at late_level >= 1
+    int nb_presented; //pictures shown
     SDL_mutex *pictq_mutex;
     SDL_cond *pictq_cond;
 
     char filename[1024];
+    StartupTimes startup; //time to the first frame, phase by phase
 }VideoState;
 
 #endif // PLAYER_H
@@ -0,0 +1,34 @@
+#ifndef PREFETCH_IO_H
+#define PREFETCH_IO_H
+
+#include <libavformat/avformat.h>
+
+#define PREFETCH_IO_RING_SIZE (16*1024*1024) //bytes prefetched ahead of the demuxer at most
+#define PREFETCH_IO_MIN_CHUNK (64*1024) //read sizes adapt between MIN_CHUNK & MAX_CHUNK
+#define PREFETCH_IO_MAX_CHUNK (2*1024*1024)
+#define PREFETCH_IO_BUFFER_SIZE (64*1024) //size of the AVIOContext buffer
+#define PREFETCH_IO_POLL_INTERVAL 10 //ms, how often a stalled demuxer checks its interrupt callback
+
+typedef struct PrefetchIOStats{
+    int fill; //bytes prefetched & not consumed yet
+    int ring_size;
+    int chunk; //current read size
+    int nb_stalls; //times the demuxer found the ring empty & had to wait for storage
+    int64_t stall_time; //time the demuxer waited for storage in total, microseconds
+    int nb_reads; //read() calls made by the I/O thread
+    int64_t bytes_read;
+}PrefetchIOStats;
+
+/** open a local file & start an I/O thread filling a ring buffer ahead of the demuxer,
+ *  the AVIOContext is served from that ring. a demuxer stalled on the ring gives up with
+ *  AVERROR_EXIT when 'int_cb' (may be NULL) says so.
+ *  returns NULL if 'filename' is not a local file */
+AVIOContext *prefetch_io_open(const char *filename, const AVIOInterruptCB *int_cb);
+
+/** stop the I/O thread, close the file & free the AVIOContext */
+void prefetch_io_close(AVIOContext **pb);
+
+/** take a snapshot of the counters */
+void prefetch_io_get_stats(AVIOContext *pb, PrefetchIOStats *st);
+
+#endif // PREFETCH_IO_H
@@ -0,0 +1,17 @@
+#ifndef PROBE_CACHE_H
+#define PROBE_CACHE_H
+
+#include <libavformat/avformat.h>
+
+#define PROBE_CACHE_SUFFIX ".spprobe" //the sidecar is saved next to the media file
+
+/** restore the stream parameters probed by a previous avformat_find_stream_info() on 'filename'
+ *  into 'ic' (just opened by avformat_open_input()).
+ *  returns 0 if they were restored & probing may be skipped, <0 if the cache is missing or stale,
+ *  'ic' is left untouched then */
+int probe_cache_load(AVFormatContext *ic, const char *filename);
+
+/** save the parameters of 'ic' (probed by avformat_find_stream_info()) for the next open */
+void probe_cache_save(AVFormatContext *ic, const char *filename);
+
+#endif // PROBE_CACHE_H
@@ -0,0 +1,30 @@
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include <libavformat/avformat.h>
+
+#define SEEK_INDEX_SUFFIX ".spidx" //the sidecar is saved next to the media file
+#define SEEK_INDEX_INTERVAL 0.5 //seconds, keyframes closer than that to the previous entry are not recorded
+
+/** keyframe index of a file: timestamps & byte offsets of the keyframes of its default stream.
+ *  containers indexed natively (mp4, mkv with cues...) need nothing; for the others the index is
+ *  loaded from a sidecar, or built by scanning the file in background & saved for the next open */
+typedef struct SeekIndex SeekIndex;
+
+/** called once 'ic' is opened & probed: load the sidecar of 'filename' into 'ic', or start scanning.
+ *  returns NULL if the file is not local or has a native index */
+SeekIndex *seek_index_open(AVFormatContext *ic, const char *filename);
+
+/** to be called by the thread reading 'ic': once the scan is over, merge its entries into 'ic'.
+ *  returns 1 when merged, 0 otherwise */
+int seek_index_update(SeekIndex *si, AVFormatContext *ic);
+
+/** seek 'ic' to the keyframe before 'ts' (AV_TIME_BASE, from the start of the file) with
+ *  AVSEEK_FLAG_BACKWARD in 'flags', or to the keyframe after it with 0.
+ *  a file indexed by us is seeked straight to the byte offset of the keyframe */
+int seek_index_seek(SeekIndex *si, AVFormatContext *ic, int64_t ts, int flags);
+
+/** stop the scan & free everything */
+void seek_index_close(SeekIndex **si);
+
+#endif // SEEK_INDEX_H
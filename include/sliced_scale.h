@@ -0,0 +1,25 @@
+#ifndef SLICED_SCALE_H
+#define SLICED_SCALE_H
+
+#include <libavutil/frame.h>
+
+#define SLICED_SCALE_MAX_THREADS 16
+#define SLICED_SCALE_ALIGN 16 //rows per band are a multiple of it, keeping the chroma rows & the dither phase
+
+/** sws_scale() of one picture split into horizontal bands, converted in parallel by a pool of
+ *  threads, each with its own SwsContext. only for same-size conversions from sources with
+ *  vertically halved chroma (NV12, YUV420P10...) to YUV420P, where every output row depends on
+ *  its own input rows & the result is the same as one sws_scale() over the whole picture */
+typedef struct SlicedScale SlicedScale;
+
+/** 'nb_threads' bands at most, the calling thread included; 0: one per CPU */
+SlicedScale *sliced_scale_create(int nb_threads);
+
+/** stop the workers & free their contexts */
+void sliced_scale_destroy(SlicedScale **ss);
+
+/** convert 'src' into the YUV420P 'dst' of the same size.
+ *  AVERROR(ENOSYS) when the conversion can't be split, the caller does it with sws_scale() then */
+int sliced_scale_frame(SlicedScale *ss, const AVFrame *src, AVFrame *dst);
+
+#endif // SLICED_SCALE_H
@@ -0,0 +1,31 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <SDL.h>
+
+//phases of the startup, from launching to the first decoded frame
+enum{
+    STARTUP_BEGIN,
+    STARTUP_OPEN, //avformat_open_input() done
+    STARTUP_PROBE, //stream parameters known (probed or from probe_cache.h)
+    STARTUP_DECODERS, //decoders opened
+    STARTUP_FIRST_PACKET, //first packet queued by the parse thread
+    STARTUP_FIRST_FRAME, //first frame decoded, audio or video
+    STARTUP_NB,
+};
+
+typedef struct StartupTimes{
+    int64_t t[STARTUP_NB]; //av_gettime() when the phase was over
+    SDL_atomic_t marked[STARTUP_NB];
+}StartupTimes;
+
+/** note the end of 'phase', only the first call of each phase counts (any thread).
+ *  the breakdown is printed to stderr as one line of JSON when STARTUP_FIRST_FRAME is marked */
+void startup_mark(StartupTimes *st, int phase);
+
+/** print the duration of each phase marked so far (ms) as one line of JSON */
+void startup_dump(StartupTimes *st, FILE *fp);
+
+#endif // STARTUP_H
@@ -0,0 +1,31 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <libavformat/avformat.h>
+
+#define URING_IO_DEPTH 8 //reads kept in flight
+#define URING_IO_BLOCK (512*1024) //bytes per read, MUST be a power of 2
+#define URING_IO_BUFFER_SIZE (64*1024) //size of the AVIOContext buffer
+
+typedef struct UringIOStats{
+    int inflight; //reads in flight now
+    int nb_submits; //reads submitted
+    int64_t inflight_sum; //sum of 'inflight' seen by every read callback, for the average queue depth
+    int nb_reads; //read callbacks served
+    int nb_waits; //times the demuxer had to wait for a completion
+    int64_t wait_time; //time the demuxer waited for storage in total, microseconds
+}UringIOStats;
+
+/** open a local file & serve an AVIOContext from reads kept in flight through io_uring.
+ *  the demuxer gives up with AVERROR_EXIT before waiting for storage if 'int_cb' (may be NULL) says so.
+ *  returns NULL if 'filename' is not a local file or io_uring is unavailable (not Linux,
+ *  old kernel, forbidden by seccomp...), in which case the default protocol should be used */
+AVIOContext *uring_io_open(const char *filename, const AVIOInterruptCB *int_cb);
+
+/** wait for the reads in flight, tear down the ring, close the file & free the AVIOContext */
+void uring_io_close(AVIOContext **pb);
+
+/** take a snapshot of the counters */
+void uring_io_get_stats(AVIOContext *pb, UringIOStats *st);
+
+#endif // URING_IO_H
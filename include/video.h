@@ -7,4 +7,10 @@ int video_init(VideoState *is);
 int video_thread(void *arg);
 void video_display(VideoState *is);
 
+/** done with pictq[pictq_rindex], let the decoder reuse its slot */
+void video_pictq_next(VideoState *is);
+
+/** print the depth & counters of the picture queue as one line of JSON */
+void video_dump_stats(VideoState *is, FILE *fp);
+
 #endif // VIDEO_H
@@ -4,6 +4,7 @@
 
 #include "player.h"
 #include "audio.h"
+#include "parse.h"
 
 #define min(x,y) ((x)<(y)?(x):(y))
 
@@ -16,9 +17,39 @@ static float cmid(float x, float min, float max){
     return (x<min) ? min : ((x>max) ? max: x);
 }
 
+//take the next audio packet, refilling the local batch from audioq once it runs dry
+static int audio_next_packet(VideoState *is, AVPacket *pkt){
+    int nb;
+
+    //queue flushed, the rest of the batch is stale
+    if(is->audio_pkts_index < is->audio_pkts_nb && is->audioq.last_serial != SDL_AtomicGet(&is->audioq.serial)){
+        while(is->audio_pkts_index < is->audio_pkts_nb){
+            av_packet_unref(&is->audio_pkts[is->audio_pkts_index++]);
+        }
+    }
+
+    if(is->audio_pkts_index >= is->audio_pkts_nb){
+        if((nb = packet_queue_get_batch(&is->audioq, is->audio_pkts, AUDIO_PKT_BATCH, 1)) < 0){
+            return -1;
+        }
+        is->audio_pkts_index = 0;
+        is->audio_pkts_nb = nb;
+    }
+
+    //first packet after a seek: restart the decoder & drop the audio up to the target
+    if(is->audioq.last_serial != is->audio_serial){
+        avcodec_flush_buffers(is->audio_ctx);
+        is->audio_serial = is->audioq.last_serial;
+        is->audio_drop_until = is->seek_target;
+    }
+
+    av_packet_move_ref(pkt, &is->audio_pkts[is->audio_pkts_index++]);
+    return 0;
+}
+
 static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int buf_size, double *pts_ptr){
     int pkt_consumed, data_size = 0;
-    double pts;
+    double pts, frame_duration;
 
     //data_size: how many bytes of frame generated
     data_size = av_samples_get_buffer_size(NULL,
@@ -33,6 +64,10 @@ static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int buf_size,
         //  1.2 is->audio_pkt_ptrδ꣬ٽһis->audio_frame
         while(is->audio_pkt_size > 0){
             int got_frame = 0;
+            if(is->audioq.last_serial != SDL_AtomicGet(&is->audioq.serial)){ //queue flushed, drop the rest of the packet
+                is->audio_pkt_size = 0;
+                break;
+            }
             pkt_consumed = avcodec_decode_audio4(is->audio_ctx, &is->audio_frame, &got_frame, is->audio_pkt_ptr);  //pkt_consumed: how many bytes of packet consumed
 
             if(pkt_consumed < 0){
@@ -43,6 +78,16 @@ static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int buf_size,
             is->audio_pkt_size -= pkt_consumed;
 
             if(got_frame){
+                startup_mark(&is->startup, STARTUP_FIRST_FRAME);
+                if(is->audio_drop_until >= 0){
+                    frame_duration = (double)is->audio_frame.nb_samples / is->audio_ctx->sample_rate;
+                    if(is->audio_clock + frame_duration <= is->audio_drop_until){ //before the seek target
+                        is->audio_clock += frame_duration;
+                        continue;
+                    }
+                    is->audio_drop_until = -1;
+                    parse_seek_landed(is);
+                }
                 /*ATTENTION:
                     swr_convert(..., in_count)
                     in_count: number of input samples available in one channel
@@ -64,13 +109,13 @@ static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int buf_size,
 
         //step 2. ´PacketQueueȡһAVPacket *
         if(is->audio_pkt_ptr->data){
-            av_free_packet(is->audio_pkt_ptr); //free on destroy ???
+            av_packet_unref(is->audio_pkt_ptr); //free on destroy ???
         }
         if(global_exit){
             return -1;
         }
 
-        if(packet_queue_get(&is->audioq, is->audio_pkt_ptr, 1) < 0){
+        if(audio_next_packet(is, is->audio_pkt_ptr) < 0){
             return -1;
         }
         is->audio_pkt_data = is->audio_pkt_ptr->data;
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <SDL.h>
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+
+#include "frame_pool.h"
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+struct FramePool{
+    SDL_mutex *mutex;
+    int sizes[FRAME_POOL_NB_CLASSES];
+    AVBufferPool *pools[FRAME_POOL_NB_CLASSES];
+    int nb_classes;
+    SDL_atomic_t nb_gets;
+    SDL_atomic_t nb_fallbacks;
+};
+
+//av_buffer_pool_init() gives no opaque to the allocator, the counters are global
+static SDL_atomic_t nb_allocs;
+static SDL_atomic_t nb_large_allocs;
+static SDL_atomic_t alloc_kbytes;
+
+static void frame_pool_free(void *opaque, uint8_t *data){
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+static AVBufferRef *frame_pool_alloc(int size){
+    size_t align = FRAME_POOL_ALIGN;
+    void *data = NULL;
+    AVBufferRef *buf;
+
+#if defined(FRAME_POOL_HUGEPAGES) && defined(MADV_HUGEPAGE)
+    if(size >= HUGE_PAGE_SIZE){
+        align = HUGE_PAGE_SIZE;
+    }
+#endif
+#if defined(_WIN32)
+    data = _aligned_malloc(size, align);
+#else
+    if(posix_memalign(&data, align, size) != 0){
+        data = NULL;
+    }
+#endif
+    if(!data){
+        return NULL;
+    }
+#if defined(FRAME_POOL_HUGEPAGES) && defined(MADV_HUGEPAGE)
+    if(align == HUGE_PAGE_SIZE){
+        madvise(data, size & ~(HUGE_PAGE_SIZE - 1), MADV_HUGEPAGE);
+    }
+#endif
+
+    buf = av_buffer_create(data, size, frame_pool_free, NULL, 0);
+    if(!buf){
+        frame_pool_free(NULL, data);
+        return NULL;
+    }
+    SDL_AtomicAdd(&nb_allocs, 1);
+    SDL_AtomicAdd(&alloc_kbytes, size >> 10);
+    if(size >= FRAME_POOL_LARGE_ALLOC){
+        SDL_AtomicAdd(&nb_large_allocs, 1);
+    }
+    return buf;
+}
+
+FramePool *frame_pool_create(void){
+    FramePool *fp = av_mallocz(sizeof(FramePool));
+
+    if(!fp){
+        return NULL;
+    }
+    fp->mutex = SDL_CreateMutex();
+    return fp;
+}
+
+void frame_pool_destroy(FramePool **fp){
+    int i;
+
+    if(!*fp){
+        return;
+    }
+    for(i=0; i<(*fp)->nb_classes; ++i){
+        av_buffer_pool_uninit(&(*fp)->pools[i]);
+    }
+    SDL_DestroyMutex((*fp)->mutex);
+    av_freep(fp);
+}
+
+//a buffer of 'size' bytes from its size class, created on first use
+static AVBufferRef *frame_pool_get(FramePool *fp, int size){
+    AVBufferPool *pool = NULL;
+    int i;
+
+    SDL_AtomicAdd(&fp->nb_gets, 1);
+    SDL_LockMutex(fp->mutex);
+    for(i=0; i<fp->nb_classes; ++i){
+        if(fp->sizes[i] == size){
+            pool = fp->pools[i];
+            break;
+        }
+    }
+    if(!pool && fp->nb_classes < FRAME_POOL_NB_CLASSES){
+        pool = av_buffer_pool_init(size, frame_pool_alloc);
+        if(pool){
+            fp->sizes[fp->nb_classes] = size;
+            fp->pools[fp->nb_classes++] = pool;
+        }
+    }
+    SDL_UnlockMutex(fp->mutex);
+
+    return pool ? av_buffer_pool_get(pool) : frame_pool_alloc(size);
+}
+
+//planes of 'frame' for a picture of w x h (padded already), linesizes multiple of FRAME_POOL_ALIGN
+static int frame_pool_fill(FramePool *fp, AVFrame *frame, int w, int h){
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int linesizes[4], sizes[4];
+    int i, unaligned;
+
+    if(!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL))){
+        return AVERROR(EINVAL);
+    }
+
+    do{
+        if(av_image_fill_linesizes(linesizes, frame->format, w) < 0){
+            return AVERROR(EINVAL);
+        }
+        w += w & ~(w - 1); //widen until every linesize is aligned
+        unaligned = 0;
+        for(i=0; i<4; ++i){
+            unaligned |= linesizes[i] % FRAME_POOL_ALIGN;
+        }
+    }while(unaligned);
+
+    //linesize times the rows of each plane, planes 1 & 2 hold the subsampled chroma
+    for(i=0; i<4 && linesizes[i]; ++i){
+        sizes[i] = linesizes[i] * ((i == 1 || i == 2) ? -((-h) >> desc->log2_chroma_h) : h);
+    }
+
+    for(i=0; i<4 && linesizes[i]; ++i){
+        //over-read margin of the SIMD code, as libavcodec's own pool
+        frame->buf[i] = frame_pool_get(fp, sizes[i] + 16 + FRAME_POOL_ALIGN - 1);
+        if(!frame->buf[i]){
+            av_frame_unref(frame);
+            return AVERROR(ENOMEM);
+        }
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = linesizes[i];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+int frame_pool_get_buffer2(AVCodecContext *s, AVFrame *frame, int flags){
+    FramePool *fp = (FramePool *)s->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int w = frame->width, h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+
+    if(!fp || !(s->codec->capabilities & AV_CODEC_CAP_DR1) || s->codec_type != AVMEDIA_TYPE_VIDEO || !desc ||
+       (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))){
+        if(fp){
+            SDL_AtomicAdd(&fp->nb_fallbacks, 1);
+        }
+        return avcodec_default_get_buffer2(s, frame, flags);
+    }
+
+    avcodec_align_dimensions2(s, &w, &h, linesize_align);
+    return frame_pool_fill(fp, frame, w, h);
+}
+
+int frame_pool_get_frame(FramePool *fp, AVFrame *frame){
+    if(!fp){
+        return av_frame_get_buffer(frame, FRAME_POOL_ALIGN);
+    }
+    return frame_pool_fill(fp, frame, frame->width, frame->height);
+}
+
+void frame_pool_dump_stats(FramePool *fp, FILE *fp_out){
+    FramePoolStats st;
+
+    st.nb_gets = fp ? SDL_AtomicGet(&fp->nb_gets) : 0;
+    st.nb_fallbacks = fp ? SDL_AtomicGet(&fp->nb_fallbacks) : 0;
+    st.nb_allocs = SDL_AtomicGet(&nb_allocs);
+    st.nb_large_allocs = SDL_AtomicGet(&nb_large_allocs);
+    st.alloc_bytes = (int64_t)SDL_AtomicGet(&alloc_kbytes) << 10;
+    fprintf(fp_out, "{\"pool\":\"frames\", \"gets\":%d, \"allocs\":%d, \"large_allocs\":%d, "
+                    "\"alloc_bytes\":%"PRId64", \"fallbacks\":%d}\n",
+            st.nb_gets, st.nb_allocs, st.nb_large_allocs, st.alloc_bytes, st.nb_fallbacks);
+}
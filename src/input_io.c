@@ -0,0 +1,89 @@
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "input_io.h"
+#include "mmap_io.h"
+#include "prefetch_io.h"
+#include "uring_io.h"
+
+const char *input_io_local_path(const char *filename){
+    if(!strncmp(filename, "file:", 5)){
+        return filename + 5;
+    }
+    if(strstr(filename, "://")){
+        return NULL;
+    }
+    return filename;
+}
+
+int input_io_file_identity(const char *filename, int64_t *size, int64_t *mtime){
+    const char *path = input_io_local_path(filename);
+#if defined(_WIN32)
+    struct _stati64 st;
+    if(!path || _stati64(path, &st) < 0 || !(st.st_mode & _S_IFREG)){
+        return -1;
+    }
+#else
+    struct stat st;
+    if(!path || stat(path, &st) < 0 || !S_ISREG(st.st_mode)){
+        return -1;
+    }
+#endif
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    return 0;
+}
+
+int input_io_interrupted(const AVIOInterruptCB *int_cb){
+    return int_cb && int_cb->callback && int_cb->callback(int_cb->opaque);
+}
+
+AVIOContext *input_io_open(const char *filename, int io_mode, const AVIOInterruptCB *int_cb){
+    switch(io_mode){
+    case IO_MODE_MMAP: //never waits but on page faults
+        return mmap_io_open(filename);
+    case IO_MODE_PREFETCH:
+        return prefetch_io_open(filename, int_cb);
+    case IO_MODE_URING:
+        return uring_io_open(filename, int_cb);
+    default:
+        return NULL;
+    }
+}
+
+void input_io_close(AVIOContext **pb, int io_mode){
+    switch(io_mode){
+    case IO_MODE_MMAP:
+        mmap_io_close(pb);
+        break;
+    case IO_MODE_PREFETCH:
+        prefetch_io_close(pb);
+        break;
+    case IO_MODE_URING:
+        uring_io_close(pb);
+        break;
+    }
+}
+
+void input_io_dump_stats(AVIOContext *pb, int io_mode, FILE *fp){
+    PrefetchIOStats st;
+    UringIOStats ust;
+
+    if(pb && io_mode == IO_MODE_URING){
+        uring_io_get_stats(pb, &ust);
+        fprintf(fp, "{\"io\":\"uring\", \"inflight\":%d, \"avg_depth\":%.2f, \"submits\":%d, "
+                    "\"reads\":%d, \"waits\":%d, \"wait_us\":%"PRId64"}\n",
+                ust.inflight, ust.nb_reads ? (double)ust.inflight_sum / ust.nb_reads : 0.0, ust.nb_submits,
+                ust.nb_reads, ust.nb_waits, ust.wait_time);
+        return;
+    }
+    if(!pb || io_mode != IO_MODE_PREFETCH){
+        return;
+    }
+    prefetch_io_get_stats(pb, &st);
+    fprintf(fp, "{\"io\":\"prefetch\", \"fill\":%d, \"ring_size\":%d, \"chunk\":%d, "
+                "\"stalls\":%d, \"stall_us\":%"PRId64", \"reads\":%d, \"bytes_read\":%"PRId64"}\n",
+            st.fill, st.ring_size, st.chunk,
+            st.nb_stalls, st.stall_time, st.nb_reads, st.bytes_read);
+}
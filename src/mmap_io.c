@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "input_io.h"
+#include "mmap_io.h"
+
+typedef struct MmapIO{
+    uint8_t *data; //the whole file
+    int64_t size;
+    int64_t pos; //reading position
+    int64_t advised; //[pos, advised) has been hinted with WILLNEED
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+}MmapIO;
+
+static int mmap_io_map(MmapIO *mio, const char *path){
+#if defined(_WIN32)
+    LARGE_INTEGER size;
+
+    mio->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(mio->file == INVALID_HANDLE_VALUE){
+        return -1;
+    }
+    if(!GetFileSizeEx(mio->file, &size) || size.QuadPart <= 0 || size.QuadPart > (SIZE_MAX >> 1)){
+        CloseHandle(mio->file);
+        return -1;
+    }
+    mio->size = size.QuadPart;
+    mio->mapping = CreateFileMapping(mio->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!mio->mapping){
+        CloseHandle(mio->file);
+        return -1;
+    }
+    mio->data = (uint8_t *)MapViewOfFile(mio->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!mio->data){
+        CloseHandle(mio->mapping);
+        CloseHandle(mio->file);
+        return -1;
+    }
+#else
+    struct stat st;
+    void *data;
+
+    mio->fd = open(path, O_RDONLY);
+    if(mio->fd < 0){
+        return -1;
+    }
+    if(fstat(mio->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > (SIZE_MAX >> 1)){
+        close(mio->fd);
+        return -1;
+    }
+    mio->size = st.st_size;
+    data = mmap(NULL, mio->size, PROT_READ, MAP_SHARED, mio->fd, 0);
+    if(data == MAP_FAILED){
+        close(mio->fd);
+        return -1;
+    }
+    mio->data = (uint8_t *)data;
+    madvise(mio->data, mio->size, MADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+static void mmap_io_unmap(MmapIO *mio){
+#if defined(_WIN32)
+    UnmapViewOfFile(mio->data);
+    CloseHandle(mio->mapping);
+    CloseHandle(mio->file);
+#else
+    munmap(mio->data, mio->size);
+    close(mio->fd);
+#endif
+}
+
+//ask the kernel to page in the data ahead of the reading position
+static void mmap_io_readahead(MmapIO *mio){
+#if !defined(_WIN32)
+    int64_t page = sysconf(_SC_PAGESIZE);
+    int64_t start, end;
+
+    if(mio->pos < mio->advised && mio->advised - mio->pos >= MMAP_IO_READAHEAD / 2){
+        return; //still plenty hinted ahead
+    }
+    start = FFMAX(mio->pos, mio->advised) & ~(page - 1);
+    end = FFMIN(mio->pos + MMAP_IO_READAHEAD, mio->size);
+    if(start < end){
+        madvise(mio->data + start, end - start, MADV_WILLNEED);
+    }
+    mio->advised = end;
+#endif
+}
+
+static int mmap_io_read(void *opaque, uint8_t *buf, int buf_size){
+    MmapIO *mio = (MmapIO *)opaque;
+    int len;
+
+    if(mio->pos >= mio->size){
+        return AVERROR_EOF;
+    }
+    len = (int)FFMIN((int64_t)buf_size, mio->size - mio->pos);
+    memcpy(buf, mio->data + mio->pos, len);
+    mio->pos += len;
+    mmap_io_readahead(mio);
+    return len;
+}
+
+static int64_t mmap_io_seek(void *opaque, int64_t offset, int whence){
+    MmapIO *mio = (MmapIO *)opaque;
+    int64_t pos;
+
+    switch(whence & ~AVSEEK_FORCE){
+    case AVSEEK_SIZE:
+        return mio->size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = mio->pos + offset;
+        break;
+    case SEEK_END:
+        pos = mio->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if(pos < 0 || pos > mio->size){
+        return AVERROR(EINVAL);
+    }
+    mio->pos = pos;
+    mio->advised = pos; //a jump, restart the read-ahead window
+    mmap_io_readahead(mio);
+    return pos;
+}
+
+AVIOContext *mmap_io_open(const char *filename){
+    const char *path = input_io_local_path(filename);
+    MmapIO *mio;
+    uint8_t *buffer;
+    AVIOContext *pb;
+
+    if(!path){
+        return NULL;
+    }
+    mio = av_mallocz(sizeof(MmapIO));
+    if(!mio){
+        return NULL;
+    }
+    if(mmap_io_map(mio, path) < 0){
+        fprintf(stderr, "mmap_io: could not map %s, fall back to file protocol.\n", path);
+        av_free(mio);
+        return NULL;
+    }
+    mmap_io_readahead(mio);
+
+    buffer = av_malloc(MMAP_IO_BUFFER_SIZE);
+    pb = buffer ? avio_alloc_context(buffer, MMAP_IO_BUFFER_SIZE, 0, mio, mmap_io_read, NULL, mmap_io_seek) : NULL;
+    if(!pb){
+        av_free(buffer);
+        mmap_io_unmap(mio);
+        av_free(mio);
+        return NULL;
+    }
+    return pb;
+}
+
+void mmap_io_close(AVIOContext **pb){
+    MmapIO *mio;
+
+    if(!*pb){
+        return;
+    }
+    mio = (MmapIO *)(*pb)->opaque;
+    mmap_io_unmap(mio);
+    av_free(mio);
+    av_freep(&(*pb)->buffer);
+    av_freep(pb);
+}
@@ -1,64 +1,170 @@
+#include "libavutil/time.h"
+
 #include "packet_queue.h"
 
+#define RING_MASK (PACKET_QUEUE_CAPACITY - 1)
+
 extern int global_exit;
+extern int global_exit_parse;
 
 void packet_queue_init(PacketQueue *q){
     memset(q, 0, sizeof(PacketQueue));
+    q->slots = av_malloc_array(PACKET_QUEUE_CAPACITY, sizeof(PacketQueueSlot));
+    if(q->slots){
+        q->stats.nb_allocs++;
+    }
+    q->last_pts = AV_NOPTS_VALUE;
     q->mutex = SDL_CreateMutex();
     q->cond = SDL_CreateCond();
+    q->space_cond = SDL_CreateCond();
 }
 
-void packet_queue_clear(PacketQueue *q) {
-    AVPacketList *pktList;
+int packet_queue_nb_packets(PacketQueue *q){
+    return (int)((unsigned)SDL_AtomicGet(&q->head) - (unsigned)SDL_AtomicGet(&q->tail));
+}
 
-    SDL_LockMutex(q->mutex);
-    while(pktList = q->first_pkt) {
-        q->first_pkt = pktList->next;
-        if(!q->first_pkt) {
-            q->last_pkt = NULL;
+static int packet_queue_full(PacketQueue *q){
+    return packet_queue_nb_packets(q) >= PACKET_QUEUE_CAPACITY;
+}
+
+//whether size or duration is down to its watermark, -1 for a watermark never reached
+static int packet_queue_drained(PacketQueue *q, int low_size, int low_duration){
+    return (low_size >= 0 && SDL_AtomicGet(&q->size) <= low_size) ||
+           (low_duration >= 0 && SDL_AtomicGet(&q->duration) <= low_duration);
+}
+
+//move up to 'max' packets of the current generation out of the ring with a single
+//acquire of head & a single release of tail, stale packets are dropped on the way (consumer only)
+static int packet_queue_pop(PacketQueue *q, AVPacket *pkts, int max){
+    PacketQueueSlot *slot;
+    int first, tail, head, serial, size = 0, duration = 0, nb = 0;
+
+    first = tail = SDL_AtomicGet(&q->tail);
+    head = SDL_AtomicGet(&q->head);
+    serial = SDL_AtomicGet(&q->serial);
+    while(tail != head && nb < max){
+        slot = &q->slots[tail & RING_MASK];
+        tail++;
+        size += slot->pkt.size;
+        duration += slot->duration;
+        if(slot->serial != serial){ //flushed, drop it
+            av_packet_unref(&slot->pkt);
+            continue;
         }
-        q->nb_packets--;
-        q->size -= pktList->pkt.size;
-        av_free(pktList);
+        av_packet_move_ref(&pkts[nb++], &slot->pkt);
+        q->last_serial = serial;
+    }
+    if(tail == first){
+        return 0; //empty
     }
-    printf("after clearing: nb=%d, size=%d\n", q->nb_packets, q->size);
+    SDL_AtomicSet(&q->tail, tail);
+    SDL_AtomicAdd(&q->size, -size);
+    SDL_AtomicAdd(&q->duration, -duration);
 
-    SDL_UnlockMutex(q->mutex);
+    //slots are free now, wake up the producer if it is sleeping & a watermark is reached
+    if(SDL_AtomicGet(&q->put_waiting) && packet_queue_drained(q, q->space_low, q->duration_low)){
+        SDL_LockMutex(q->mutex);
+        SDL_CondSignal(q->space_cond);
+        SDL_UnlockMutex(q->mutex);
+    }
+    return nb;
 }
 
-int packet_queue_put(PacketQueue *q, AVPacket *pkt){
-    //wrap AVPacket in a AVPacketList, which is a element of the list
-    AVPacketList *pktList;
-    if(av_dup_packet(pkt) != 0){
-        return -1;
+void packet_queue_clear(PacketQueue *q) {
+    SDL_AtomicAdd(&q->serial, 1);
+}
+
+void packet_queue_destroy(PacketQueue *q){
+    AVPacket pkt;
+
+    while(packet_queue_nb_packets(q) > 0){
+        if(packet_queue_pop(q, &pkt, 1) > 0){
+            av_packet_unref(&pkt);
+        }
     }
+    av_freep(&q->slots);
+    SDL_DestroyCond(q->space_cond);
+    SDL_DestroyCond(q->cond);
+    SDL_DestroyMutex(q->mutex);
+}
 
-    pktList = av_malloc(sizeof(AVPacketList));
-    if(!pktList) return -1;
-    pktList->pkt = *pkt;
-    pktList->next = NULL;
+int packet_queue_put(PacketQueue *q, AVPacket *pkt){
+    PacketQueueSlot *slot;
+    int head, nb, size, duration, serial;
+    int64_t wait_start;
 
-    //
-    SDL_LockMutex(q->mutex);
+    //slow path: the ring is full, sleep until the consumer frees a slot or the queue is cleared
+    if(packet_queue_full(q)){
+        serial = SDL_AtomicGet(&q->serial);
+        wait_start = av_gettime();
+        q->stats.nb_full_waits++;
+        SDL_LockMutex(q->mutex);
+        q->space_low = INT_MAX; //any free slot will do
+        q->duration_low = -1;
+        SDL_AtomicSet(&q->put_waiting, 1);
+        while(packet_queue_full(q) && !global_exit && !global_exit_parse && SDL_AtomicGet(&q->serial) == serial){
+            SDL_CondWait(q->space_cond, q->mutex);
+        }
+        SDL_AtomicSet(&q->put_waiting, 0);
+        SDL_UnlockMutex(q->mutex);
+        q->stats.full_wait_time += av_gettime() - wait_start;
 
-    if(!q->last_pkt) q->first_pkt = pktList;
-    else q->last_pkt->next = pktList;
+        if(packet_queue_full(q)){ //quitting or cleared
+            return -1;
+        }
+    }
 
-    q->last_pkt = pktList;
-    q->nb_packets++;
-    q->size += pktList->pkt.size;
+    //fill the slot, then publish it by moving head forward
+    head = SDL_AtomicGet(&q->head);
+    slot = &q->slots[head & RING_MASK];
+    if(pkt->buf){ //refcounted (as av_read_frame() gives), no copy at all
+        av_packet_move_ref(&slot->pkt, pkt);
+    }else{
+        if(av_packet_ref(&slot->pkt, pkt) < 0){
+            return -1;
+        }
+        q->stats.nb_allocs++;
+        q->stats.nb_copied_bytes += pkt->size;
+        av_packet_unref(pkt);
+    }
+    slot->serial = SDL_AtomicGet(&q->serial);
 
-    SDL_CondSignal(q->cond);
-    SDL_UnlockMutex(q->mutex);
+    //no duration given by the demuxer, estimate it from the previous pts
+    slot->duration = slot->pkt.duration;
+    if(slot->duration <= 0 && slot->pkt.pts != AV_NOPTS_VALUE && q->last_pts != AV_NOPTS_VALUE &&
+       slot->pkt.pts > q->last_pts && slot->pkt.pts - q->last_pts < INT_MAX){
+        slot->duration = (int)(slot->pkt.pts - q->last_pts);
+    }
+    if(slot->duration < 0) slot->duration = 0;
+    if(slot->pkt.pts != AV_NOPTS_VALUE) q->last_pts = slot->pkt.pts;
+    duration = SDL_AtomicAdd(&q->duration, slot->duration) + slot->duration;
+    q->stats.nb_node_reuses++;
+    size = SDL_AtomicAdd(&q->size, slot->pkt.size) + slot->pkt.size;
+    SDL_AtomicSet(&q->head, head + 1);
+
+    //high-water marks
+    nb = packet_queue_nb_packets(q);
+    if(nb > q->stats.max_nb_packets) q->stats.max_nb_packets = nb;
+    if(size > q->stats.max_size) q->stats.max_size = size;
+    if(duration > q->stats.max_duration) q->stats.max_duration = duration;
+
+    //wake up the consumer if it is sleeping on an empty ring
+    if(SDL_AtomicGet(&q->get_waiting)){
+        SDL_LockMutex(q->mutex);
+        SDL_CondSignal(q->cond);
+        SDL_UnlockMutex(q->mutex);
+    }
 
     return 0;
 }
 
 int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block){
-    AVPacketList *pktList;
-    int ret;
+    return packet_queue_get_batch(q, pkt, 1, block);
+}
 
-    SDL_LockMutex(q->mutex);
+int packet_queue_get_batch(PacketQueue *q, AVPacket *pkts, int max, int block){
+    int ret;
+    int64_t wait_start = 0, wait_time;
 
     for(;;){
         //if(quit_get_from_queue){
@@ -67,30 +173,90 @@ int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block){
             break;
         }
 
-        //
-        pktList = q->first_pkt;
-        if(pktList){ //read all elements from the list
-            q->first_pkt = pktList->next;
-            if(!q->first_pkt){
-                q->last_pkt = NULL;
-            }
-            q->nb_packets--;
-            q->size -= pktList->pkt.size;
-            *pkt = pktList->pkt;
-            av_free(pktList);
-
-            ret = 1;
+        //fast path: no locking at all
+        if((ret = packet_queue_pop(q, pkts, max)) > 0){
             break;
-        }else {
-            if(!block){ //return if non-blocking
-                ret = 0;
-                break;
-            }else{
-                SDL_CondWait(q->cond, q->mutex);
-            }
         }
+        if(packet_queue_nb_packets(q) > 0){ //only stale packets dropped, try again
+            continue;
+        }
+
+        if(!block){ //return if non-blocking
+            ret = 0;
+            break;
+        }
+
+        //slow path: the ring is empty, sleep until the producer publishes a slot
+        if(!wait_start){
+            wait_start = av_gettime();
+            q->stats.nb_empty_waits++;
+        }
+        SDL_LockMutex(q->mutex);
+        SDL_AtomicSet(&q->get_waiting, 1);
+        if(packet_queue_nb_packets(q) == 0 && !global_exit){
+            SDL_CondWait(q->cond, q->mutex);
+        }
+        SDL_AtomicSet(&q->get_waiting, 0);
+        SDL_UnlockMutex(q->mutex);
     }//end for(;;)
 
+    if(wait_start){
+        wait_time = av_gettime() - wait_start;
+        q->stats.wait_time += wait_time;
+        if(wait_time > q->stats.max_wait_time) q->stats.max_wait_time = wait_time;
+    }
+    return ret;
+}
+
+int packet_queue_wait_space(PacketQueue *q, int low_size, int low_duration){
+    int ret, serial;
+    int64_t wait_start;
+
+    serial = SDL_AtomicGet(&q->serial);
+    wait_start = av_gettime();
+    q->stats.nb_full_waits++;
+    SDL_LockMutex(q->mutex);
+    q->space_low = low_size;
+    q->duration_low = low_duration;
+    SDL_AtomicSet(&q->put_waiting, 1);
+    while(!packet_queue_drained(q, low_size, low_duration) && !global_exit && !global_exit_parse &&
+          SDL_AtomicGet(&q->serial) == serial){
+        SDL_CondWait(q->space_cond, q->mutex);
+    }
+    SDL_AtomicSet(&q->put_waiting, 0);
+    ret = (global_exit || global_exit_parse) ? -1 : 0;
     SDL_UnlockMutex(q->mutex);
+    q->stats.full_wait_time += av_gettime() - wait_start;
+
     return ret;
 }
+
+void packet_queue_wakeup(PacketQueue *q){
+    SDL_LockMutex(q->mutex);
+    SDL_CondBroadcast(q->cond);
+    SDL_CondBroadcast(q->space_cond);
+    SDL_UnlockMutex(q->mutex);
+}
+
+void packet_queue_get_stats(PacketQueue *q, PacketQueueStats *st){
+    *st = q->stats;
+    st->nb_packets = packet_queue_nb_packets(q);
+    st->size = SDL_AtomicGet(&q->size);
+    st->duration = SDL_AtomicGet(&q->duration);
+}
+
+void packet_queue_dump_stats(PacketQueue *q, const char *name, FILE *fp){
+    PacketQueueStats st;
+
+    packet_queue_get_stats(q, &st);
+    fprintf(fp, "{\"queue\":\"%s\", \"nb_packets\":%d, \"size\":%d, \"duration\":%d, "
+                "\"max_nb_packets\":%d, \"max_size\":%d, \"max_duration\":%d, "
+                "\"empty_waits\":%d, \"wait_us\":%"PRId64", \"max_wait_us\":%"PRId64", "
+                "\"full_waits\":%d, \"full_wait_us\":%"PRId64", "
+                "\"allocs\":%d, \"copied_bytes\":%"PRId64"}\n",
+            name, st.nb_packets, st.size, st.duration,
+            st.max_nb_packets, st.max_size, st.max_duration,
+            st.nb_empty_waits, st.wait_time, st.max_wait_time,
+            st.nb_full_waits, st.full_wait_time,
+            st.nb_allocs, st.nb_copied_bytes);
+}
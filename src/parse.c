@@ -1,48 +1,252 @@
+#include <float.h>
+#include "libavutil/time.h"
+
 #include "player.h"
 #include "parse.h"
 
 extern int global_exit;
 extern int global_exit_parse;
 
-int parse_thread(void *arg)
+/* sleep until parse_thread_wakeup() or parse_thread_seek() is called */
+static void wait_for_wakeup(VideoState *is)
 {
-    VideoState *is = (VideoState *)arg;
-    AVPacket pkt1, *packet = &pkt1;
+    SDL_LockMutex(is->parse_mutex);
+    if(!global_exit_parse && !SDL_AtomicGet(&is->seek_req))
+    {
+        SDL_CondWait(is->parse_cond, is->parse_mutex);
+    }
+    SDL_UnlockMutex(is->parse_mutex);
+}
+
+void parse_thread_wakeup(VideoState *is)
+{
+    SDL_LockMutex(is->parse_mutex);
+    SDL_CondBroadcast(is->parse_cond);
+    SDL_UnlockMutex(is->parse_mutex);
+
+    packet_queue_wakeup(&is->audioq);
+    packet_queue_wakeup(&is->videoq);
+}
+
+void parse_thread_quit(VideoState *is)
+{
+    is->quit_time = av_gettime();
+    global_exit_parse = 1;
+    global_exit = 1;
+    parse_thread_wakeup(is);
+}
+
+void parse_seek_landed(VideoState *is)
+{
+    if(SDL_AtomicCAS(&is->seek_landed, 0, 1))
+    {
+        fprintf(stderr, "seek to first frame: %.1f ms\n", (av_gettime() - is->seek_time) / 1000.0);
+    }
+}
+
+int parse_interrupt_cb(void *opaque)
+{
+    VideoState *is = (VideoState *)opaque;
+
+    return global_exit_parse || SDL_AtomicGet(&is->seek_req);
+}
 
-    //seek to position (audio seeking supported ONLY)
+void parse_thread_seek(VideoState *is, int64_t pos)
+{
+    SDL_LockMutex(is->parse_mutex);
+    is->seek_pos = pos;
+    is->seek_time = av_gettime();
+    SDL_AtomicSet(&is->seek_req, 1);
+    SDL_CondBroadcast(is->parse_cond);
+    SDL_UnlockMutex(is->parse_mutex);
+
+    //drop what is buffered at once, this also gets the parse thread out of a wait on a full queue
     packet_queue_clear(&is->audioq);
+    packet_queue_clear(&is->videoq);
+    packet_queue_wakeup(&is->audioq);
+    packet_queue_wakeup(&is->videoq);
+}
+
+void parse_thread_trick_play(VideoState *is, int speed, int64_t pos)
+{
+    SDL_AtomicSet(&is->trick_speed, speed);
+    parse_thread_seek(is, pos);
+}
 
-    AVRational time_base = is->audio_st->time_base;
-    //printf("seek_target==%d/%d\n", time_base.num, time_base.den);
-    //printf("start_time==%d\n", is->audio_st->start_time);
-    //printf("0===%d\n", av_rescale(0, time_base.den, time_base.num));
-    //printf("1===%d\n", av_rescale(1, time_base.den, time_base.num));
-    //printf("2===%d\n", av_rescale(2, time_base.den, time_base.num));
-    int64_t seek_time = is->audio_st->start_time + av_rescale(is->seek_pos_sec, time_base.den, time_base.num);
-    //printf("seek_time=%d, cur_dts=%d\n", seek_time, is->audio_st->cur_dts);
-    if(seek_time > is->audio_st->cur_dts) {
-        av_seek_frame(is->pFormatCtx, is->audio_stream_index, seek_time, AVSEEK_FLAG_ANY);
-    } else {
-        av_seek_frame(is->pFormatCtx, is->audio_stream_index, seek_time, AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD);
+/* carry out the pending seek request: the demuxer goes to the keyframe before it (see seek_index.h),
+ * the decoders are flushed when they see the new generation of the queues & drop frames up to it */
+static void do_seek(VideoState *is)
+{
+    int64_t pos, seek_time;
+
+    //cleared first, so that the interrupt callback lets this seek through
+    SDL_LockMutex(is->parse_mutex);
+    pos = is->seek_pos;
+    seek_time = is->seek_time;
+    SDL_AtomicSet(&is->seek_req, 0);
+    SDL_UnlockMutex(is->parse_mutex);
+
+    //a read interrupted by the request left an error behind
+    if(is->pFormatCtx->pb)
+    {
+        is->pFormatCtx->pb->error = 0;
+    }
+    if(seek_index_seek(is->seek_index, is->pFormatCtx, pos, AVSEEK_FLAG_BACKWARD) < 0)
+    {
+        fprintf(stderr, "%s: error while seeking.\n", is->filename);
     }
+    //trick play starts with whatever keyframe comes first
+    is->trick_last = SDL_AtomicGet(&is->trick_speed) > 0 ? -DBL_MAX : DBL_MAX;
+    is->trick_miss = 0;
+    if(is->pFormatCtx->start_time != AV_NOPTS_VALUE)
+    {
+        pos += is->pFormatCtx->start_time;
+    }
+    is->seek_target = (double)pos / AV_TIME_BASE;
+    SDL_AtomicSet(&is->seek_landed, 0);
 
+    //packets read between the request & the seek are stale as well,
+    //the target is published together with the new generation
+    packet_queue_clear(&is->audioq);
+    packet_queue_clear(&is->videoq);
+    fprintf(stderr, "seek latency: %.1f ms\n", (av_gettime() - seek_time) / 1000.0);
+}
+
+/* seconds buffered in a queue, 0 for a stream not opened */
+static double queue_duration(PacketQueue *q, AVStream *st)
+{
+    if(!st)
+        return 0;
+    return SDL_AtomicGet(&q->duration) * av_q2d(st->time_base);
+}
+
+/* convert seconds into the time_base of a stream, to be a watermark of its queue */
+static int queue_duration_mark(AVStream *st, double seconds)
+{
+    return (int)(seconds / av_q2d(st->time_base));
+}
+
+/* trick play: queue the video keyframe in 'packet' (drop anything else), then jump the demuxer
+ * to the next keyframe far enough in the direction of the scan */
+static void trick_play(VideoState *is, AVPacket *packet)
+{
+    int speed = SDL_AtomicGet(&is->trick_speed);
+    AVStream *st = is->video_st;
+    double pts, target, start = 0;
+    int64_t ts;
+
+    ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if(!st || packet->stream_index != is->video_stream_index || !(packet->flags & AV_PKT_FLAG_KEY) || ts == AV_NOPTS_VALUE)
+    {
+        av_packet_unref(packet); //audio muted
+        return;
+    }
+    pts = ts * av_q2d(st->time_base);
+    if(is->pFormatCtx->start_time != AV_NOPTS_VALUE)
+        start = (double)is->pFormatCtx->start_time / AV_TIME_BASE;
+
+    if((speed > 0 && pts <= is->trick_last) || (speed < 0 && pts >= is->trick_last))
+    {
+        //landed on a keyframe shown already, jump further
+        av_packet_unref(packet);
+        if(++is->trick_miss > TRICK_PLAY_MAX_MISS)
+        {
+            fprintf(stderr, "trick play: no more keyframes, back to normal playback.\n");
+            target = fabs(is->trick_last) == DBL_MAX ? 0 : FFMAX(is->trick_last - start, 0);
+            parse_thread_trick_play(is, 0, (int64_t)(target * AV_TIME_BASE));
+            return;
+        }
+    }
+    else
+    {
+        if(packet_queue_put(&is->videoq, packet) < 0)
+            av_packet_unref(packet);
+        is->trick_last = pts;
+        is->trick_miss = 0;
+    }
+
+    //so many seconds between two keyframes shown keep TRICK_PLAY_FPS at 'speed'
+    target = is->trick_last + (double)speed / TRICK_PLAY_FPS * (1 + is->trick_miss);
+    target = FFMAX(target - start, 0);
+    seek_index_seek(is->seek_index, is->pFormatCtx, (int64_t)(target * AV_TIME_BASE), speed < 0 ? AVSEEK_FLAG_BACKWARD : 0);
+}
+
+/* block while the queues hold enough; returns 0 if reading may go on, 1 after sleeping */
+static int throttle(VideoState *is)
+{
+    double audio_dur = queue_duration(&is->audioq, is->audio_st);
+    double video_dur = queue_duration(&is->videoq, is->video_st);
+    int audio_size = SDL_AtomicGet(&is->audioq.size);
+    int video_size = SDL_AtomicGet(&is->videoq.size);
+
+    //trick play: a few keyframes ahead are enough, the demuxer jumps anyway
+    if(SDL_AtomicGet(&is->trick_speed) != 0)
+    {
+        if(packet_queue_nb_packets(&is->videoq) < TRICK_PLAY_QUEUE_SIZE)
+            return 0;
+        packet_queue_wait_space(&is->videoq, 0, -1);
+        return 1;
+    }
+
+    //backstop: memory ceiling reached, drain the bigger queue to half
+    if(audio_size + video_size > MAX_QUEUES_SIZE)
+    {
+        if(audio_size > video_size)
+            packet_queue_wait_space(&is->audioq, audio_size / 2, -1);
+        else
+            packet_queue_wait_space(&is->videoq, video_size / 2, -1);
+        return 1;
+    }
+
+    //a stream starving below the minimum keeps the reading going
+    if((is->audio_st && audio_dur < MIN_QUEUE_DURATION) || (is->video_st && video_dur < MIN_QUEUE_DURATION))
+        return 0;
+
+    if(is->audio_st && audio_dur > MAX_QUEUE_DURATION)
+    {
+        packet_queue_wait_space(&is->audioq, -1, queue_duration_mark(is->audio_st, MAX_QUEUE_DURATION / 2));
+        return 1;
+    }
+    if(is->video_st && video_dur > MAX_QUEUE_DURATION)
+    {
+        packet_queue_wait_space(&is->videoq, -1, queue_duration_mark(is->video_st, MAX_QUEUE_DURATION / 2));
+        return 1;
+    }
+    return 0;
+}
+
+int parse_thread(void *arg)
+{
+    VideoState *is = (VideoState *)arg;
+    AVPacket pkt1, *packet = &pkt1;
 
     for(;;)
     {
         if(global_exit_parse) break;
-        //seek stuff goes here ???
 
-        //reading too fast, slow down!
-        if(is->audioq.size > MAX_AUDIOQ_SIZE || is->videoq.size > MAX_VIDEOQ_SIZE)
+        //the keyframe scan is over, make its index available to the seeks
+        seek_index_update(is->seek_index, is->pFormatCtx);
+
+        //seek requested, in place
+        if(SDL_AtomicGet(&is->seek_req))
+        {
+            do_seek(is);
+        }
+
+        //reading too fast, sleep until the decoders drain half of the queue
+        if(throttle(is) != 0)
         {
-            SDL_Delay(10);
             continue;
         }
         if(av_read_frame(is->pFormatCtx, packet) < 0)
         {
+            if(SDL_AtomicGet(&is->seek_req))
+            {
+                continue; /* interrupted by a seek request */
+            }
             if(is->pFormatCtx->pb->error == 0)
             {
-                SDL_Delay(100); /* no error; wait for user input */
+                wait_for_wakeup(is); /* no error; wait for user input */
                 continue;
             }
             else
@@ -51,24 +255,34 @@ int parse_thread(void *arg)
             }
         }
 
-        if(packet->stream_index == is->audio_stream_index)
+        if(SDL_AtomicGet(&is->trick_speed) != 0)
         {
-            packet_queue_put(&is->audioq, packet);
+            trick_play(is, packet);
+        }
+        else if(packet->stream_index == is->audio_stream_index)
+        {
+            if(packet_queue_put(&is->audioq, packet) < 0)
+                av_packet_unref(packet);
+            else
+                startup_mark(&is->startup, STARTUP_FIRST_PACKET);
         }
         else if(packet->stream_index == is->video_stream_index)
         {
-            packet_queue_put(&is->videoq, packet);
+            if(packet_queue_put(&is->videoq, packet) < 0)
+                av_packet_unref(packet);
+            else
+                startup_mark(&is->startup, STARTUP_FIRST_PACKET);
         }
         else
         {
-            av_free_packet(packet);
+            av_packet_unref(packet);
         }
     }
 
     /* wait for quitting */
     while(!global_exit_parse)
     {
-        SDL_Delay(100);
+        wait_for_wakeup(is);
     }
 
     /* free facilities for audio/video playing */
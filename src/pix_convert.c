@@ -0,0 +1,255 @@
+#include <string.h>
+#include "libavutil/pixfmt.h"
+#include "libavutil/error.h"
+
+#include "pix_convert.h"
+
+//x86 intrinsics in functions of their own target, gcc 4.9 & later
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PIX_CONVERT_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define PIX_CONVERT_X86 0
+#endif
+
+#ifndef bit_AVX2
+#define bit_AVX2 0x20
+#endif
+
+typedef void (*DeinterleaveRow)(const uint8_t *src, uint8_t *u, uint8_t *v, int w);
+typedef void (*AverageRow)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int w);
+typedef void (*DitherRow)(const uint16_t *src, uint8_t *dst, int w, int d0, int d1);
+
+/** ************** rows, plain C ************** */
+static void deinterleave_row_c(const uint8_t *src, uint8_t *u, uint8_t *v, int w){
+    int i;
+
+    for(i=0; i<w; ++i){
+        u[i] = src[2*i];
+        v[i] = src[2*i+1];
+    }
+}
+
+//rounded up, as SWS_AREA halves the chroma rows
+static void average_row_c(const uint8_t *a, const uint8_t *b, uint8_t *dst, int w){
+    int i;
+
+    for(i=0; i<w; ++i){
+        dst[i] = (a[i] + b[i] + 1) >> 1;
+    }
+}
+
+//10 bits to 8 as swscale does for the same size: 'd0' added to the even samples & 'd1' to the odd ones,
+//then shifted, 1023 + 3 saturating to 255
+static void dither_row_c(const uint16_t *src, uint8_t *dst, int w, int d0, int d1){
+    int i, x;
+
+    for(i=0; i<w; ++i){
+        x = (src[i] + ((i & 1) ? d1 : d0)) >> 2;
+        dst[i] = x - (x >> 8);
+    }
+}
+
+#if PIX_CONVERT_X86
+/** ************** rows, SSE2 ************** */
+__attribute__((target("sse2")))
+static void deinterleave_row_sse2(const uint8_t *src, uint8_t *u, uint8_t *v, int w){
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    __m128i a, b;
+    int i;
+
+    for(i=0; i+16<=w; i+=16){
+        a = _mm_loadu_si128((const __m128i *)(src + 2*i));
+        b = _mm_loadu_si128((const __m128i *)(src + 2*i + 16));
+        _mm_storeu_si128((__m128i *)(u + i), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *)(v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    deinterleave_row_c(src + 2*i, u + i, v + i, w - i);
+}
+
+__attribute__((target("sse2")))
+static void average_row_sse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int w){
+    int i;
+
+    for(i=0; i+16<=w; i+=16){
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                                            _mm_loadu_si128((const __m128i *)(b + i))));
+    }
+    average_row_c(a + i, b + i, dst + i, w - i);
+}
+
+__attribute__((target("sse2")))
+static void dither_row_sse2(const uint16_t *src, uint8_t *dst, int w, int d0, int d1){
+    const __m128i dither = _mm_set1_epi32(d0 | (d1 << 16));
+    __m128i a, b;
+    int i;
+
+    for(i=0; i+16<=w; i+=16){
+        a = _mm_srli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(src + i)), dither), 2);
+        b = _mm_srli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(src + i + 8)), dither), 2);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b)); //256 saturates to 255
+    }
+    dither_row_c(src + i, dst + i, w - i, d0, d1);
+}
+
+/** ************** rows, AVX2 ************** */
+//packs work within the 128-bit lanes, the permute puts the quadwords back in order
+__attribute__((target("avx2")))
+static void deinterleave_row_avx2(const uint8_t *src, uint8_t *u, uint8_t *v, int w){
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    __m256i a, b;
+    int i;
+
+    for(i=0; i+32<=w; i+=32){
+        a = _mm256_loadu_si256((const __m256i *)(src + 2*i));
+        b = _mm256_loadu_si256((const __m256i *)(src + 2*i + 32));
+        _mm256_storeu_si256((__m256i *)(u + i),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask)), 0xD8));
+        _mm256_storeu_si256((__m256i *)(v + i),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8)), 0xD8));
+    }
+    deinterleave_row_c(src + 2*i, u + i, v + i, w - i);
+}
+
+__attribute__((target("avx2")))
+static void average_row_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int w){
+    int i;
+
+    for(i=0; i+32<=w; i+=32){
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                                                  _mm256_loadu_si256((const __m256i *)(b + i))));
+    }
+    average_row_c(a + i, b + i, dst + i, w - i);
+}
+
+__attribute__((target("avx2")))
+static void dither_row_avx2(const uint16_t *src, uint8_t *dst, int w, int d0, int d1){
+    const __m256i dither = _mm256_set1_epi32(d0 | (d1 << 16));
+    __m256i a, b;
+    int i;
+
+    for(i=0; i+32<=w; i+=32){
+        a = _mm256_srli_epi16(_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(src + i)), dither), 2);
+        b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(src + i + 16)), dither), 2);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    dither_row_c(src + i, dst + i, w - i, d0, d1);
+}
+#endif
+
+/** ************** pictures ************** */
+static void copy_plane(const uint8_t *src, int src_linesize, uint8_t *dst, int dst_linesize, int w, int h){
+    int y;
+
+    for(y=0; y<h; ++y){
+        memcpy(dst + y*dst_linesize, src + y*src_linesize, w);
+    }
+}
+
+static int convert_nv12(const AVFrame *src, AVFrame *dst, DeinterleaveRow deinterleave){
+    int cw = (src->width + 1) >> 1, ch = (src->height + 1) >> 1;
+    int y;
+
+    copy_plane(src->data[0], src->linesize[0], dst->data[0], dst->linesize[0], src->width, src->height);
+    for(y=0; y<ch; ++y){
+        deinterleave(src->data[1] + y*src->linesize[1],
+                     dst->data[1] + y*dst->linesize[1], dst->data[2] + y*dst->linesize[2], cw);
+    }
+    return 0;
+}
+
+//chroma rows 2y & 2y+1 averaged. for odd heights swscale weighs 3 rows per output row, left to it
+static int convert_yuv422p(const AVFrame *src, AVFrame *dst, AverageRow average){
+    int cw = (src->width + 1) >> 1, ch = src->height >> 1;
+    int p, y;
+
+    if((src->height & 1) || src->height < 4){
+        return AVERROR(ENOSYS);
+    }
+    copy_plane(src->data[0], src->linesize[0], dst->data[0], dst->linesize[0], src->width, src->height);
+    for(p=1; p<3; ++p){
+        for(y=0; y<ch; ++y){
+            average(src->data[p] + 2*y*src->linesize[p], src->data[p] + (2*y+1)*src->linesize[p],
+                    dst->data[p] + y*dst->linesize[p], cw);
+        }
+    }
+    return 0;
+}
+
+//ordered dither of swscale, 1 2 on the even rows of each plane & 3 0 on the odd ones
+static int convert_yuv420p10(const AVFrame *src, AVFrame *dst, DitherRow dither){
+    int p, y, w, h;
+
+    for(p=0; p<3; ++p){
+        w = p ? (src->width + 1) >> 1 : src->width;
+        h = p ? (src->height + 1) >> 1 : src->height;
+        for(y=0; y<h; ++y){
+            dither((const uint16_t *)(src->data[p] + y*src->linesize[p]), dst->data[p] + y*dst->linesize[p], w,
+                   (y & 1) ? 3 : 1, (y & 1) ? 0 : 2);
+        }
+    }
+    return 0;
+}
+
+#define PIX_CONVERT_KERNELS(isa) \
+static int nv12_##isa(const AVFrame *src, AVFrame *dst){ return convert_nv12(src, dst, deinterleave_row_##isa); } \
+static int yuv422p_##isa(const AVFrame *src, AVFrame *dst){ return convert_yuv422p(src, dst, average_row_##isa); } \
+static int yuv420p10_##isa(const AVFrame *src, AVFrame *dst){ return convert_yuv420p10(src, dst, dither_row_##isa); }
+
+PIX_CONVERT_KERNELS(c)
+#if PIX_CONVERT_X86
+PIX_CONVERT_KERNELS(sse2)
+PIX_CONVERT_KERNELS(avx2)
+#endif
+
+int pix_convert_cpu_flags(void){
+    int flags = 0;
+#if PIX_CONVERT_X86
+    unsigned int eax, ebx, ecx, edx, xcr0;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+        return 0;
+    }
+    if(edx & bit_SSE2){
+        flags |= PIX_CONVERT_SSE2;
+    }
+    //AVX2 also takes the OS saving the ymm registers
+    if((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_max(0, NULL) >= 7){
+        __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if((xcr0 & 6) == 6 && (ebx & bit_AVX2)){
+            flags |= PIX_CONVERT_AVX2;
+        }
+    }
+#endif
+    return flags;
+}
+
+PixConvertFunc pix_convert_get(int format, int cpu_flags, const char **name){
+    PixConvertFunc nv12 = nv12_c, yuv422p = yuv422p_c, yuv420p10 = yuv420p10_c;
+    const char *isa = "c";
+
+#if PIX_CONVERT_X86
+    if(cpu_flags & PIX_CONVERT_AVX2){
+        nv12 = nv12_avx2, yuv422p = yuv422p_avx2, yuv420p10 = yuv420p10_avx2;
+        isa = "avx2";
+    }else if(cpu_flags & PIX_CONVERT_SSE2){
+        nv12 = nv12_sse2, yuv422p = yuv422p_sse2, yuv420p10 = yuv420p10_sse2;
+        isa = "sse2";
+    }
+#endif
+    *name = isa;
+    switch(format){
+    case AV_PIX_FMT_NV12:
+        return nv12;
+    case AV_PIX_FMT_YUV422P:
+        return yuv422p;
+    case AV_PIX_FMT_YUV420P10LE:
+        return yuv420p10;
+    default:
+        *name = "sws_scale";
+        return NULL;
+    }
+}
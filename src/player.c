@@ -10,11 +10,16 @@ extern "C"
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
+#include <libavutil/time.h>
+#include <libavutil/pixdesc.h>
 #include <SDL.h>
 
 #include "audio.h"
 #include "video.h"
 #include "parse.h"
+#include "input_io.h"
+#include "seek_index.h"
+#include "probe_cache.h"
 #include "player.h"
 
 #ifdef __cplusplus
@@ -27,17 +32,41 @@ static VideoState *is; //global video state
 
 static int open_input()
 {
+    //local files are read as io_mode says, others by the protocol of their url
+    //blocking I/O gives up at once when quitting or seeking
+    is->pFormatCtx = avformat_alloc_context();
+    is->pFormatCtx->interrupt_callback.callback = parse_interrupt_cb;
+    is->pFormatCtx->interrupt_callback.opaque = is;
+    is->io_ctx = input_io_open(is->filename, is->io_mode, &is->pFormatCtx->interrupt_callback);
+    if(is->io_ctx)
+    {
+        is->pFormatCtx->pb = is->io_ctx;
+    }
+
     if(avformat_open_input(&is->pFormatCtx, is->filename, NULL, NULL) != 0)
     {
         fprintf(stderr, "could not open video file.\n");
+        //libavformat frees the format context only, a custom pb stays ours
+        input_io_close(&is->io_ctx, is->io_mode);
         return -1;
     }
-    if(avformat_find_stream_info(is->pFormatCtx, NULL) < 0)
+    startup_mark(&is->startup, STARTUP_OPEN);
+
+    //probing decodes frames, reuse what was probed at the last launch if the file has not changed
+    if(probe_cache_load(is->pFormatCtx, is->filename) < 0)
     {
-        fprintf(stderr, "could not find stream info.\n");
-        return -1;
+        if(avformat_find_stream_info(is->pFormatCtx, NULL) < 0)
+        {
+            fprintf(stderr, "could not find stream info.\n");
+            return -1;
+        }
+        probe_cache_save(is->pFormatCtx, is->filename);
     }
+    startup_mark(&is->startup, STARTUP_PROBE);
     av_dump_format(is->pFormatCtx, 0, is->filename, 0);
+
+    //keyframe index for seeking, loaded from its sidecar or built in background
+    is->seek_index = seek_index_open(is->pFormatCtx, is->filename);
     return 0;
 }
 
@@ -92,6 +121,20 @@ static int stream_component_open(int stream_index)
         fprintf(stderr, "spec.format=%d (size & type of each sample)\n", spec.format);
     }
 
+    //video frames are kept by reference when shown without conversion,
+    //their planes are recycled through the frame pool
+    if(codecCtx->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        codecCtx->refcounted_frames = 1;
+        is->frame_pool = frame_pool_create();
+        codecCtx->opaque = is->frame_pool;
+        codecCtx->get_buffer2 = frame_pool_get_buffer2;
+        codecCtx->thread_safe_callbacks = 1;
+
+        codecCtx->thread_count = is->decode_threads > 0 ? is->decode_threads : SDL_GetCPUCount();
+        codecCtx->thread_type = is->decode_thread_type;
+    }
+
     //open decoder
     if(avcodec_open2(codecCtx, codec, NULL) < 0)
     {
@@ -99,6 +142,14 @@ static int stream_component_open(int stream_index)
         return -1;
     }
 
+    if(codecCtx->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        //frame threads hold thread_count-1 frames back, synchronize_video() goes by the frame pts anyway
+        fprintf(stderr, "video decoding: %d thread(s), %s%s\n", codecCtx->thread_count,
+                (codecCtx->active_thread_type & FF_THREAD_FRAME) ? "frame " : "",
+                (codecCtx->active_thread_type & FF_THREAD_SLICE) ? "slice" : "");
+    }
+
     //initialize 'is' audio/video info
     switch(codecCtx->codec_type)
     {
@@ -135,11 +186,26 @@ static int stream_component_open(int stream_index)
         is->frame_timer = (double)av_gettime() / 1000000.0;
         is->frame_last_delay = 40e-3; //40ms
 
-        is->sws_ctx = sws_getContext(is->video_ctx->width, is->video_ctx->height,
-                                     is->video_ctx->pix_fmt,
-                                     is->video_ctx->width, is->video_ctx->height,
-                                     PIX_FMT_YUV420P,SWS_BICUBIC,
-                                     NULL, NULL, NULL);
+        //YUV420P frames go to the texture as they are, a converter is needed for the others
+        if(is->video_ctx->pix_fmt != PIX_FMT_YUV420P)
+        {
+            const char *kernel;
+
+            //same-size NV12, YUV422P & YUV420P10 by hand, swscale for the rest & the frames of another format
+            is->pix_convert = pix_convert_get(is->video_ctx->pix_fmt, pix_convert_cpu_flags(), &kernel);
+            is->pix_convert_format = is->video_ctx->pix_fmt;
+            fprintf(stderr, "video conversion: %s -> yuv420p, %s\n", av_get_pix_fmt_name(is->video_ctx->pix_fmt), kernel);
+
+            is->sws_ctx = sws_getContext(is->video_ctx->width, is->video_ctx->height,
+                                         is->video_ctx->pix_fmt,
+                                         is->video_ctx->width, is->video_ctx->height,
+                                         PIX_FMT_YUV420P,SWS_BICUBIC,
+                                         NULL, NULL, NULL);
+            if(!is->pix_convert)
+            {
+                is->sliced_scale = sliced_scale_create(is->scale_threads);
+            }
+        }
 
         break;
     }
@@ -215,6 +281,18 @@ static int open_video_decoder()
     return 0;
 }
 
+#ifdef SHOW_QUEUE_STATS
+static Uint32 queue_stats_timer_cb(Uint32 interval, void *opaque){
+    VideoState *is = (VideoState *)opaque;
+    packet_queue_dump_stats(&is->audioq, "audioq", stderr);
+    packet_queue_dump_stats(&is->videoq, "videoq", stderr);
+    video_dump_stats(is, stderr);
+    frame_pool_dump_stats(is->frame_pool, stderr);
+    input_io_dump_stats(is->io_ctx, is->io_mode, stderr);
+    return interval;
+}
+#endif
+
 /** **************************** video displaying(main thread) **************************** **/
 static Uint32 video_refresh_timer_cb(Uint32 delay, void *opaque){
     SDL_Event event;
@@ -228,6 +306,7 @@ static void video_refresh_timer(void *userdata){
     VideoState *is = (VideoState *)userdata;
     VideoPicture *vp;
     double actural_delay, delay, diff;
+    int speed = SDL_AtomicGet(&is->trick_speed);
 
     //decoder not opened -> check later
     if(!is->video_st){
@@ -236,36 +315,59 @@ static void video_refresh_timer(void *userdata){
     }
     assert(is->video_st != NULL);
 
+    //pictures decoded before a seek are not shown
+    while(is->pictq_size > 0 && is->pictq[is->pictq_rindex].serial != SDL_AtomicGet(&is->videoq.serial)){
+        video_pictq_next(is);
+    }
+
     //YUV image not ready -> check later
     if(is->pictq_size == 0){
+        is->pictq_nb_empty++;
         SDL_AddTimer(1, video_refresh_timer_cb, is);
         return;
     }
     assert(is->pictq_size > 0);
 
     //
-    vp = &is->pictq;
+    vp = &is->pictq[is->pictq_rindex];
+
+    //first picture since the decoder was opened or flushed: however long the decoding
+    //threads took to deliver it, the timer starts from now
+    if(vp->serial != is->frame_serial || is->frame_last_pts == 0){
+        is->frame_serial = vp->serial;
+        is->frame_timer = av_gettime() / 1000000.0;
+        is->frame_last_pts = vp->pts;
+    }
 
 #if 1
-    //maintain delay & pts
-    delay = vp->pts - is->frame_last_pts;
-    if(delay <= 0 || delay >= 1.0){ //unit: second
-        delay = is->frame_last_delay;
-    }
-    delay = fmax(delay, AV_SYNC_THRESHOLD);
-    is->frame_last_delay = delay;
-    is->frame_last_pts = vp->pts;
-
-    //(update delay to sync to audio)
-    diff = vp->pts - get_audio_clock(is);
-    if(fabs(diff) <= AV_NOSYNC_THRESHOLD){ //if it's possible to sync
-        if(diff <= -delay){
-            delay = 0; //speed video up
-        }else{
-            delay = 2 * delay; //slow video down
+    if(speed != 0){
+        //trick play: keyframes paced at the distance between their pts over the speed, no audio to follow
+        delay = fabs(vp->pts - is->frame_last_pts) / abs(speed);
+        delay = av_clipd(delay, 1.0 / TRICK_PLAY_FPS, 1.0);
+        is->frame_last_delay = delay;
+        is->frame_last_pts = vp->pts;
+        is->frame_timer += delay;
+    }else{
+        //maintain delay & pts
+        delay = vp->pts - is->frame_last_pts;
+        if(delay <= 0 || delay >= 1.0){ //unit: second
+            delay = is->frame_last_delay;
+        }
+        delay = fmax(delay, AV_SYNC_THRESHOLD);
+        is->frame_last_delay = delay;
+        is->frame_last_pts = vp->pts;
+
+        //(update delay to sync to audio)
+        diff = vp->pts - get_audio_clock(is);
+        if(fabs(diff) <= AV_NOSYNC_THRESHOLD){ //if it's possible to sync
+            if(diff <= -delay){
+                delay = 0; //speed video up
+            }else{
+                delay = 2 * delay; //slow video down
+            }
         }
+        is->frame_timer += delay;
     }
-    is->frame_timer += delay;
 
     actural_delay = is->frame_timer - (av_gettime() / 1000000.0);
     actural_delay = fmax(actural_delay, 0.010);
@@ -280,10 +382,50 @@ static void video_refresh_timer(void *userdata){
     video_display(is);
 
     //hunger for more, please decoding!
-    SDL_LockMutex(is->pictq_mutex);
-    --is->pictq_size;
-    SDL_CondSignal(is->pictq_cond);
-    SDL_UnlockMutex(is->pictq_mutex);
+    video_pictq_next(is);
+}
+
+/* position of the picture on screen, from the start of the file */
+static int64_t current_position()
+{
+    double pos = is->frame_last_pts;
+
+    if(is->pFormatCtx->start_time != AV_NOPTS_VALUE)
+        pos -= (double)is->pFormatCtx->start_time / AV_TIME_BASE;
+    return (int64_t)(FFMAX(pos, 0) * AV_TIME_BASE);
+}
+
+/* 'f' doubles the speed of the forward scan, 'r' of the rewind, 'n' goes back to normal playback */
+static void trick_play_key(int key)
+{
+    int speed = SDL_AtomicGet(&is->trick_speed);
+
+    switch(key){
+    case SDLK_f:
+        speed = speed > 0 ? FFMIN(speed * 2, TRICK_PLAY_MAX_SPEED) : 2;
+        break;
+    case SDLK_r:
+        speed = speed < 0 ? FFMAX(speed * 2, -TRICK_PLAY_MAX_SPEED) : -2;
+        break;
+    default:
+        speed = 0;
+        break;
+    }
+    fprintf(stderr, "trick play: %dx\n", speed);
+    parse_thread_trick_play(is, speed, current_position());
+}
+
+/* seek 'incr' seconds away from the current position */
+static void seek_relative(double incr)
+{
+    double pos = get_audio_clock(is) + incr;
+
+    if(is->pFormatCtx->start_time != AV_NOPTS_VALUE)
+        pos -= (double)is->pFormatCtx->start_time / AV_TIME_BASE;
+    if(pos < 0)
+        pos = 0;
+    fprintf(stderr, "seek to %.2f (sec)\n", pos);
+    parse_thread_seek(is, (int64_t)(pos * AV_TIME_BASE));
 }
 
 int main_player(int argc, char* argv[])
@@ -300,10 +442,19 @@ int main_player(int argc, char* argv[])
 
     is = av_mallocz(sizeof(VideoState)); //memory allocation with alignment, why???
     strncpy(is->filename, argv[1], sizeof(is->filename));
+    is->io_mode = IO_MODE;
+    is->decode_threads = VIDEO_DECODE_THREADS;
+    is->decode_thread_type = VIDEO_DECODE_THREAD_TYPE;
+    is->scale_threads = VIDEO_SCALE_THREADS;
     is->pictq_mutex = SDL_CreateMutex();
     is->pictq_cond = SDL_CreateCond();
+    is->parse_mutex = SDL_CreateMutex();
+    is->parse_cond = SDL_CreateCond();
+    packet_queue_init(&is->audioq);
+    packet_queue_init(&is->videoq);
     is->audio_stream_index = -1;
     is->video_stream_index = -1;
+    is->audio_drop_until = -1;
 
     //register all formats & codecs
     av_register_all();
@@ -315,6 +466,7 @@ int main_player(int argc, char* argv[])
         exit(1);
     }
 
+    startup_mark(&is->startup, STARTUP_BEGIN);
     if(open_input() != 0) {
         av_free(is);
         return -1;
@@ -324,6 +476,7 @@ int main_player(int argc, char* argv[])
         av_free(is);
         return -1;
     }
+    startup_mark(&is->startup, STARTUP_DECODERS);
 
     //parsing thread (reading packets from stream)
     parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
@@ -348,6 +501,9 @@ int main_player(int argc, char* argv[])
     //once AVCodecContext is known, the size of window is known
     video_init(is);
     SDL_AddTimer(40, video_refresh_timer_cb, is);
+#ifdef SHOW_QUEUE_STATS
+    SDL_AddTimer(QUEUE_STATS_INTERVAL, queue_stats_timer_cb, is);
+#endif
 
     refresh_cnt = 0;
     for(;;){
@@ -357,10 +513,32 @@ int main_player(int argc, char* argv[])
             //fprintf(stderr, "[fre%ld]", ++refresh_cnt);
             video_refresh_timer(sdlEvent.user.data1);
             break;
+        case SDL_KEYDOWN:
+            switch(sdlEvent.key.keysym.sym){
+            case SDLK_LEFT:
+                seek_relative(-10.0);
+                break;
+            case SDLK_RIGHT:
+                seek_relative(10.0);
+                break;
+            case SDLK_UP:
+                seek_relative(60.0);
+                break;
+            case SDLK_DOWN:
+                seek_relative(-60.0);
+                break;
+            case SDLK_f:
+            case SDLK_r:
+            case SDLK_n:
+                trick_play_key(sdlEvent.key.keysym.sym);
+                break;
+            default:
+                break;
+            }
+            break;
         case SDL_QUIT:
             fprintf(stderr, "event:quit\n");
-            global_exit_parse = 1;
-            global_exit = 1;
+            parse_thread_quit(is);
             break;
         default:
             //fprintf(stderr, "event:%d\n", sdlEvent.type);
@@ -377,6 +555,18 @@ int main_player(int argc, char* argv[])
     SDL_WaitThread(parse_tid, NULL);
     SDL_WaitThread(video_tid, NULL);
 
+    fprintf(stderr, "shutdown latency: %.1f ms\n", (av_gettime() - is->quit_time) / 1000.0);
     SDL_Quit();
+
+    seek_index_close(&is->seek_index);
+    avformat_close_input(&is->pFormatCtx);
+    input_io_close(&is->io_ctx, is->io_mode);
+
+    packet_queue_destroy(&is->audioq);
+    packet_queue_destroy(&is->videoq);
+    frame_pool_destroy(&is->frame_pool);
+    sliced_scale_destroy(&is->sliced_scale);
+    SDL_DestroyCond(is->parse_cond);
+    SDL_DestroyMutex(is->parse_mutex);
     return 0;
 }
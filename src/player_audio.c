@@ -10,11 +10,16 @@ extern "C"
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
+#include <libavutil/time.h>
+#include <libavutil/pixdesc.h>
 #include <SDL.h>
 
 #include "audio.h"
 #include "video.h"
 #include "parse.h"
+#include "input_io.h"
+#include "seek_index.h"
+#include "probe_cache.h"
 #include "player.h"
 
 #ifdef __cplusplus
@@ -34,17 +39,41 @@ static VideoState *is; //global video state
 
 static int open_input()
 {
+    //local files are read as io_mode says, others by the protocol of their url
+    //blocking I/O gives up at once when quitting or seeking
+    is->pFormatCtx = avformat_alloc_context();
+    is->pFormatCtx->interrupt_callback.callback = parse_interrupt_cb;
+    is->pFormatCtx->interrupt_callback.opaque = is;
+    is->io_ctx = input_io_open(is->filename, is->io_mode, &is->pFormatCtx->interrupt_callback);
+    if(is->io_ctx)
+    {
+        is->pFormatCtx->pb = is->io_ctx;
+    }
+
     if(avformat_open_input(&is->pFormatCtx, is->filename, NULL, NULL) != 0)
     {
         fprintf(stderr, "could not open video file.\n");
+        //libavformat frees the format context only, a custom pb stays ours
+        input_io_close(&is->io_ctx, is->io_mode);
         return -1;
     }
-    if(avformat_find_stream_info(is->pFormatCtx, NULL) < 0)
+    startup_mark(&is->startup, STARTUP_OPEN);
+
+    //probing decodes frames, reuse what was probed at the last launch if the file has not changed
+    if(probe_cache_load(is->pFormatCtx, is->filename) < 0)
     {
-        fprintf(stderr, "could not find stream info.\n");
-        return -1;
+        if(avformat_find_stream_info(is->pFormatCtx, NULL) < 0)
+        {
+            fprintf(stderr, "could not find stream info.\n");
+            return -1;
+        }
+        probe_cache_save(is->pFormatCtx, is->filename);
     }
+    startup_mark(&is->startup, STARTUP_PROBE);
     av_dump_format(is->pFormatCtx, 0, is->filename, 0);
+
+    //keyframe index for seeking, loaded from its sidecar or built in background
+    is->seek_index = seek_index_open(is->pFormatCtx, is->filename);
     return 0;
 }
 
@@ -99,6 +128,20 @@ static int stream_component_open(int stream_index)
         fprintf(stderr, "spec.format=%d (size & type of each sample)\n", spec.format);
     }
 
+    //video frames are kept by reference when shown without conversion,
+    //their planes are recycled through the frame pool
+    if(codecCtx->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        codecCtx->refcounted_frames = 1;
+        is->frame_pool = frame_pool_create();
+        codecCtx->opaque = is->frame_pool;
+        codecCtx->get_buffer2 = frame_pool_get_buffer2;
+        codecCtx->thread_safe_callbacks = 1;
+
+        codecCtx->thread_count = is->decode_threads > 0 ? is->decode_threads : SDL_GetCPUCount();
+        codecCtx->thread_type = is->decode_thread_type;
+    }
+
     //open decoder
     if(avcodec_open2(codecCtx, codec, NULL) < 0)
     {
@@ -106,6 +149,14 @@ static int stream_component_open(int stream_index)
         return -1;
     }
 
+    if(codecCtx->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        //frame threads hold thread_count-1 frames back, synchronize_video() goes by the frame pts anyway
+        fprintf(stderr, "video decoding: %d thread(s), %s%s\n", codecCtx->thread_count,
+                (codecCtx->active_thread_type & FF_THREAD_FRAME) ? "frame " : "",
+                (codecCtx->active_thread_type & FF_THREAD_SLICE) ? "slice" : "");
+    }
+
     //initialize 'is' audio/video info
     switch(codecCtx->codec_type)
     {
@@ -143,11 +194,26 @@ static int stream_component_open(int stream_index)
         is->frame_timer = (double)av_gettime() / 1000000.0;
         is->frame_last_delay = 40e-3; //40ms
 
-        is->sws_ctx = sws_getContext(is->video_ctx->width, is->video_ctx->height,
-                                     is->video_ctx->pix_fmt,
-                                     is->video_ctx->width, is->video_ctx->height,
-                                     PIX_FMT_YUV420P,SWS_BICUBIC,
-                                     NULL, NULL, NULL);
+        //YUV420P frames go to the texture as they are, a converter is needed for the others
+        if(is->video_ctx->pix_fmt != PIX_FMT_YUV420P)
+        {
+            const char *kernel;
+
+            //same-size NV12, YUV422P & YUV420P10 by hand, swscale for the rest & the frames of another format
+            is->pix_convert = pix_convert_get(is->video_ctx->pix_fmt, pix_convert_cpu_flags(), &kernel);
+            is->pix_convert_format = is->video_ctx->pix_fmt;
+            fprintf(stderr, "video conversion: %s -> yuv420p, %s\n", av_get_pix_fmt_name(is->video_ctx->pix_fmt), kernel);
+
+            is->sws_ctx = sws_getContext(is->video_ctx->width, is->video_ctx->height,
+                                         is->video_ctx->pix_fmt,
+                                         is->video_ctx->width, is->video_ctx->height,
+                                         PIX_FMT_YUV420P,SWS_BICUBIC,
+                                         NULL, NULL, NULL);
+            if(!is->pix_convert)
+            {
+                is->sliced_scale = sliced_scale_create(is->scale_threads);
+            }
+        }
 
         break;
     }
@@ -189,6 +255,16 @@ static int open_audio_decoder()
     return 0;
 }
 
+#ifdef SHOW_QUEUE_STATS
+static Uint32 queue_stats_timer_cb(Uint32 interval, void *opaque){
+    VideoState *is = (VideoState *)opaque;
+    packet_queue_dump_stats(&is->audioq, "audioq", stderr);
+    packet_queue_dump_stats(&is->videoq, "videoq", stderr);
+    input_io_dump_stats(is->io_ctx, is->io_mode, stderr);
+    return interval;
+}
+#endif
+
 int main(int argc, char* argv[])
 {
     SDL_Event sdlEvent;
@@ -202,8 +278,16 @@ int main(int argc, char* argv[])
     is = av_mallocz(sizeof(VideoState)); //memory allocation with alignment, why???
     is->audio_stream_index = -1;
     is->video_stream_index = -1;
+    is->audio_drop_until = -1;
     strncpy(is->filename, argv[1], sizeof(is->filename));
-    is->seek_pos_sec = 0;
+    is->io_mode = IO_MODE;
+    is->decode_threads = VIDEO_DECODE_THREADS;
+    is->decode_thread_type = VIDEO_DECODE_THREAD_TYPE;
+    is->scale_threads = VIDEO_SCALE_THREADS;
+    is->parse_mutex = SDL_CreateMutex();
+    is->parse_cond = SDL_CreateCond();
+    packet_queue_init(&is->audioq);
+    packet_queue_init(&is->videoq);
 
     //register all formats & codecs
     av_register_all();
@@ -215,6 +299,7 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    startup_mark(&is->startup, STARTUP_BEGIN);
     if(open_input() != 0) {
         av_free(is);
         return -1;
@@ -224,6 +309,7 @@ int main(int argc, char* argv[])
         av_free(is);
         return -1;
     }
+    startup_mark(&is->startup, STARTUP_DECODERS);
 
     //parsing thread (reading packets from stream)
     parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
@@ -234,6 +320,9 @@ int main(int argc, char* argv[])
     }
 
     SDL_PauseAudio(0);
+#ifdef SHOW_QUEUE_STATS
+    SDL_AddTimer(QUEUE_STATS_INTERVAL, queue_stats_timer_cb, is);
+#endif
 
     {
         char line[128];
@@ -253,8 +342,7 @@ int main(int argc, char* argv[])
                 continue;
             switch(cmd) {
             case 'q':
-                global_exit = 1;
-                global_exit_parse = 1;
+                parse_thread_quit(is);
                 break;
             case 'p':
                 SDL_PauseAudio(1);
@@ -265,18 +353,7 @@ int main(int argc, char* argv[])
             case 's':
                 if(num == 2) {
                     printf("seek to %d (sec)\n", sec);
-                    global_exit_parse = 1;
-                    SDL_WaitThread(parse_tid, NULL);
-                    global_exit_parse = 0;
-
-                    is->seek_pos_sec = sec;
-                    parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
-                    if(!parse_tid) {
-                        fprintf(stderr, "create parsing thread failed.\n");
-                        av_free(is);
-                        return -1;
-                    }
-
+                    parse_thread_seek(is, (int64_t)sec * AV_TIME_BASE);
                     SDL_PauseAudio(0);
                 }
                 break;
@@ -292,6 +369,18 @@ int main(int argc, char* argv[])
 
     SDL_WaitThread(parse_tid, NULL);
 
+    fprintf(stderr, "shutdown latency: %.1f ms\n", (av_gettime() - is->quit_time) / 1000.0);
     SDL_Quit();
+
+    seek_index_close(&is->seek_index);
+    avformat_close_input(&is->pFormatCtx);
+    input_io_close(&is->io_ctx, is->io_mode);
+
+    packet_queue_destroy(&is->audioq);
+    packet_queue_destroy(&is->videoq);
+    frame_pool_destroy(&is->frame_pool);
+    sliced_scale_destroy(&is->sliced_scale);
+    SDL_DestroyCond(is->parse_cond);
+    SDL_DestroyMutex(is->parse_mutex);
     return 0;
 }
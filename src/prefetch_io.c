@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#define lseek _lseeki64
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include <SDL.h>
+#include "libavutil/time.h"
+
+#include "input_io.h"
+#include "prefetch_io.h"
+
+typedef struct PrefetchIO{
+    int fd;
+    int64_t file_size;
+
+    //ring[rindex, ... , rindex+fill-1] (wrapping around) holds the file from offset 'pos' on,
+    //the I/O thread appends behind it, the demuxer consumes from rindex
+    uint8_t *ring;
+    int rindex;
+    int fill;
+    int64_t pos;
+    int eof;
+    int error;
+
+    int seek_req; //the demuxer wants the file from 'seek_pos' on
+    int64_t seek_pos;
+    int abort_req;
+    AVIOInterruptCB int_cb;
+
+    int chunk; //adaptive read size
+    int stalled; //the demuxer stalled since the last read
+
+    PrefetchIOStats stats;
+
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *data_cond; //signalled on new data, seek done, eof or error
+    SDL_cond *space_cond; //signalled on consumed data, seek/abort requested
+}PrefetchIO;
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+static void prefetch_io_advise(PrefetchIO *pio, int64_t offset, int advice){
+    posix_fadvise(pio->fd, offset, PREFETCH_IO_RING_SIZE, advice);
+}
+#endif
+
+static int prefetch_io_thread(void *arg){
+    PrefetchIO *pio = (PrefetchIO *)arg;
+    int windex, len, n;
+
+    SDL_LockMutex(pio->mutex);
+    while(!pio->abort_req){
+        if(pio->seek_req){
+            //drop everything prefetched & start over from the new position
+            if(lseek(pio->fd, pio->seek_pos, SEEK_SET) < 0){
+                pio->error = AVERROR(errno);
+            }else{
+                pio->error = 0;
+            }
+            pio->pos = pio->seek_pos;
+            pio->rindex = 0;
+            pio->fill = 0;
+            pio->eof = 0;
+            pio->seek_req = 0;
+            pio->chunk = PREFETCH_IO_MIN_CHUNK; //small reads first, the demuxer is waiting
+#if defined(POSIX_FADV_WILLNEED)
+            prefetch_io_advise(pio, pio->pos, POSIX_FADV_WILLNEED);
+#endif
+            SDL_CondBroadcast(pio->data_cond);
+            continue;
+        }
+
+        //ring full, eof or error: nothing to do until the demuxer consumes or seeks
+        if(pio->eof || pio->error || PREFETCH_IO_RING_SIZE - pio->fill < PREFETCH_IO_MIN_CHUNK){
+            SDL_CondWait(pio->space_cond, pio->mutex);
+            continue;
+        }
+
+        windex = (pio->rindex + pio->fill) % PREFETCH_IO_RING_SIZE;
+        len = FFMIN(pio->chunk, PREFETCH_IO_RING_SIZE - pio->fill);
+        len = FFMIN(len, PREFETCH_IO_RING_SIZE - windex);
+
+        //[windex, windex+len) is invisible to the demuxer until 'fill' grows, read without the lock
+        SDL_UnlockMutex(pio->mutex);
+        n = read(pio->fd, pio->ring + windex, len);
+        SDL_LockMutex(pio->mutex);
+
+        pio->stats.nb_reads++;
+        if(pio->seek_req){
+            continue; //stale data, the seek will reposition the file
+        }
+        if(n < 0){
+            pio->error = AVERROR(errno);
+        }else if(n == 0){
+            pio->eof = 1;
+        }else{
+            pio->fill += n;
+            pio->stats.bytes_read += n;
+
+            //bigger reads while ahead of the demuxer, smaller ones once it had to wait
+            if(pio->stalled){
+                pio->chunk = FFMAX(pio->chunk / 2, PREFETCH_IO_MIN_CHUNK);
+                pio->stalled = 0;
+            }else if(n == len && pio->chunk < PREFETCH_IO_MAX_CHUNK){
+                pio->chunk *= 2;
+            }
+        }
+        SDL_CondBroadcast(pio->data_cond);
+    }
+    SDL_UnlockMutex(pio->mutex);
+    return 0;
+}
+
+static int prefetch_io_read(void *opaque, uint8_t *buf, int buf_size){
+    PrefetchIO *pio = (PrefetchIO *)opaque;
+    int64_t wait_start = 0;
+    int len, ret;
+
+    SDL_LockMutex(pio->mutex);
+    while(!pio->fill && !pio->eof && !pio->error && !pio->abort_req){
+        if(!wait_start){
+            wait_start = av_gettime();
+            pio->stats.nb_stalls++;
+            pio->stalled = 1;
+        }
+        if(input_io_interrupted(&pio->int_cb)){
+            break;
+        }
+        SDL_CondWaitTimeout(pio->data_cond, pio->mutex, PREFETCH_IO_POLL_INTERVAL);
+    }
+    if(wait_start){
+        pio->stats.stall_time += av_gettime() - wait_start;
+    }
+    if(!pio->fill && !pio->eof && !pio->error && !pio->abort_req){
+        SDL_UnlockMutex(pio->mutex);
+        return AVERROR_EXIT; //interrupted
+    }
+    if(!pio->fill){
+        ret = pio->error ? pio->error : AVERROR_EOF;
+        SDL_UnlockMutex(pio->mutex);
+        return ret;
+    }
+    len = FFMIN(buf_size, pio->fill);
+    len = FFMIN(len, PREFETCH_IO_RING_SIZE - pio->rindex);
+    SDL_UnlockMutex(pio->mutex);
+
+    //[rindex, rindex+fill) is never touched by the I/O thread
+    memcpy(buf, pio->ring + pio->rindex, len);
+
+    SDL_LockMutex(pio->mutex);
+    pio->rindex = (pio->rindex + len) % PREFETCH_IO_RING_SIZE;
+    pio->fill -= len;
+    pio->pos += len;
+    SDL_CondSignal(pio->space_cond);
+    SDL_UnlockMutex(pio->mutex);
+
+    return len;
+}
+
+static int64_t prefetch_io_seek(void *opaque, int64_t offset, int whence){
+    PrefetchIO *pio = (PrefetchIO *)opaque;
+    int64_t pos;
+
+    SDL_LockMutex(pio->mutex);
+    switch(whence & ~AVSEEK_FORCE){
+    case AVSEEK_SIZE:
+        SDL_UnlockMutex(pio->mutex);
+        return pio->file_size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = pio->pos + offset;
+        break;
+    case SEEK_END:
+        pos = pio->file_size + offset;
+        break;
+    default:
+        SDL_UnlockMutex(pio->mutex);
+        return AVERROR(EINVAL);
+    }
+    if(pos < 0){
+        SDL_UnlockMutex(pio->mutex);
+        return AVERROR(EINVAL);
+    }
+
+    if(pos >= pio->pos && pos <= pio->pos + pio->fill){
+        //forward within the prefetched data, just skip
+        pio->rindex = (pio->rindex + (int)(pos - pio->pos)) % PREFETCH_IO_RING_SIZE;
+        pio->fill -= (int)(pos - pio->pos);
+        pio->pos = pos;
+    }else{
+        //let the I/O thread restart from there & wait for it
+        pio->seek_pos = pos;
+        pio->seek_req = 1;
+        SDL_CondSignal(pio->space_cond);
+        while(pio->seek_req && !pio->abort_req){
+            if(input_io_interrupted(&pio->int_cb)){
+                break;
+            }
+            SDL_CondWaitTimeout(pio->data_cond, pio->mutex, PREFETCH_IO_POLL_INTERVAL);
+        }
+        //interrupted before the I/O thread took the request: withdraw it, so that the ring
+        //keeps following the old position the demuxer still reads from
+        if(pio->seek_req){
+            pio->seek_req = 0;
+            SDL_UnlockMutex(pio->mutex);
+            return AVERROR_EXIT;
+        }
+    }
+    SDL_CondSignal(pio->space_cond);
+    SDL_UnlockMutex(pio->mutex);
+    return pos;
+}
+
+AVIOContext *prefetch_io_open(const char *filename, const AVIOInterruptCB *int_cb){
+    const char *path = input_io_local_path(filename);
+    PrefetchIO *pio;
+    uint8_t *buffer;
+    AVIOContext *pb;
+
+    if(!path){
+        return NULL;
+    }
+    pio = av_mallocz(sizeof(PrefetchIO));
+    if(!pio){
+        return NULL;
+    }
+    pio->fd = open(path, O_RDONLY | O_BINARY);
+    if(pio->fd < 0){
+        av_free(pio);
+        return NULL;
+    }
+    pio->file_size = lseek(pio->fd, 0, SEEK_END);
+    lseek(pio->fd, 0, SEEK_SET);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    prefetch_io_advise(pio, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    pio->ring = av_malloc(PREFETCH_IO_RING_SIZE);
+    pio->chunk = PREFETCH_IO_MIN_CHUNK;
+    if(int_cb){
+        pio->int_cb = *int_cb;
+    }
+    pio->stats.ring_size = PREFETCH_IO_RING_SIZE;
+    pio->mutex = SDL_CreateMutex();
+    pio->data_cond = SDL_CreateCond();
+    pio->space_cond = SDL_CreateCond();
+    buffer = av_malloc(PREFETCH_IO_BUFFER_SIZE);
+    pb = (pio->ring && buffer) ? avio_alloc_context(buffer, PREFETCH_IO_BUFFER_SIZE, 0, pio, prefetch_io_read, NULL, prefetch_io_seek) : NULL;
+    if(pb){
+        pio->thread = SDL_CreateThread(prefetch_io_thread, "PREFETCH_IO_THREAD", pio);
+    }
+    if(!pb || !pio->thread){
+        fprintf(stderr, "prefetch_io: could not set up %s, fall back to file protocol.\n", path);
+        if(pb){
+            av_freep(&pb->buffer);
+            av_freep(&pb);
+        }else{
+            av_free(buffer);
+        }
+        SDL_DestroyCond(pio->space_cond);
+        SDL_DestroyCond(pio->data_cond);
+        SDL_DestroyMutex(pio->mutex);
+        av_free(pio->ring);
+        close(pio->fd);
+        av_free(pio);
+        return NULL;
+    }
+    return pb;
+}
+
+void prefetch_io_close(AVIOContext **pb){
+    PrefetchIO *pio;
+
+    if(!*pb){
+        return;
+    }
+    pio = (PrefetchIO *)(*pb)->opaque;
+
+    SDL_LockMutex(pio->mutex);
+    pio->abort_req = 1;
+    SDL_CondBroadcast(pio->space_cond);
+    SDL_CondBroadcast(pio->data_cond);
+    SDL_UnlockMutex(pio->mutex);
+    SDL_WaitThread(pio->thread, NULL);
+
+    SDL_DestroyCond(pio->space_cond);
+    SDL_DestroyCond(pio->data_cond);
+    SDL_DestroyMutex(pio->mutex);
+    av_free(pio->ring);
+    close(pio->fd);
+    av_free(pio);
+    av_freep(&(*pb)->buffer);
+    av_freep(pb);
+}
+
+void prefetch_io_get_stats(AVIOContext *pb, PrefetchIOStats *st){
+    PrefetchIO *pio = (PrefetchIO *)pb->opaque;
+
+    SDL_LockMutex(pio->mutex);
+    *st = pio->stats;
+    st->fill = pio->fill;
+    st->chunk = pio->chunk;
+    SDL_UnlockMutex(pio->mutex);
+}
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "input_io.h"
+#include "probe_cache.h"
+
+#define PROBE_CACHE_MAGIC "silly_player probe cache 2"
+#define PROBE_CACHE_MAX_EXTRADATA (1 << 20)
+
+/** what avformat_find_stream_info() fills in & the decoders read, for one stream.
+ *  a record is parsed whole into one of these before anything of the context is touched */
+typedef struct ProbeCacheStream {
+    AVRational time_base, avg_frame_rate, r_frame_rate, sample_aspect_ratio;
+    int64_t duration, start_time, nb_frames;
+    AVRational codec_time_base, codec_sample_aspect_ratio;
+    unsigned int codec_tag;
+    int ticks_per_frame, bit_rate, profile, level;
+    int bits_per_coded_sample, bits_per_raw_sample;
+    int width, height, pix_fmt, has_b_frames, field_order;
+    int color_range, color_primaries, color_trc, colorspace, chroma_sample_location;
+    int sample_rate, channels, sample_fmt, frame_size, block_align, initial_padding, seek_preroll;
+    uint64_t channel_layout;
+    uint8_t *extradata;
+    int extradata_size;
+} ProbeCacheStream;
+
+static void probe_cache_path(const char *filename, char *path, int size){
+    snprintf(path, size, "%s%s", input_io_local_path(filename), PROBE_CACHE_SUFFIX);
+}
+
+static int probe_cache_read_stream(FILE *fp, AVFormatContext *ic, unsigned int index, ProbeCacheStream *ps){
+    AVCodecContext *c = ic->streams[index]->codec;
+    int type, codec_id, i, byte;
+    unsigned int idx;
+
+    if(fscanf(fp, "stream %u type %d codec %d", &idx, &type, &codec_id) != 3
+       || idx != index || type != c->codec_type || codec_id != c->codec_id){
+        return -1; //the demuxer sees other streams now
+    }
+    if(fscanf(fp, " tb %d %d duration %"SCNd64" start %"SCNd64" nb_frames %"SCNd64
+                  " avg_fr %d %d r_fr %d %d sar %d %d\n",
+              &ps->time_base.num, &ps->time_base.den, &ps->duration, &ps->start_time, &ps->nb_frames,
+              &ps->avg_frame_rate.num, &ps->avg_frame_rate.den, &ps->r_frame_rate.num, &ps->r_frame_rate.den,
+              &ps->sample_aspect_ratio.num, &ps->sample_aspect_ratio.den) != 11){
+        return -1;
+    }
+    if(fscanf(fp, "codec tb %d %d ticks %d tag %u bit_rate %d profile %d level %d bits %d %d\n",
+              &ps->codec_time_base.num, &ps->codec_time_base.den, &ps->ticks_per_frame, &ps->codec_tag,
+              &ps->bit_rate, &ps->profile, &ps->level, &ps->bits_per_coded_sample, &ps->bits_per_raw_sample) != 9){
+        return -1;
+    }
+    if(fscanf(fp, "video %d %d %d sar %d %d delay %d field %d color %d %d %d %d %d\n",
+              &ps->width, &ps->height, &ps->pix_fmt,
+              &ps->codec_sample_aspect_ratio.num, &ps->codec_sample_aspect_ratio.den, &ps->has_b_frames, &ps->field_order,
+              &ps->color_range, &ps->color_primaries, &ps->color_trc, &ps->colorspace, &ps->chroma_sample_location) != 12){
+        return -1;
+    }
+    if(fscanf(fp, "audio %d %d %"SCNu64" %d %d block_align %d padding %d preroll %d\n",
+              &ps->sample_rate, &ps->channels, &ps->channel_layout, &ps->sample_fmt, &ps->frame_size,
+              &ps->block_align, &ps->initial_padding, &ps->seek_preroll) != 8){
+        return -1;
+    }
+
+    if(fscanf(fp, "extradata %d ", &ps->extradata_size) != 1
+       || ps->extradata_size < 0 || ps->extradata_size > PROBE_CACHE_MAX_EXTRADATA){
+        return -1;
+    }
+    if(ps->extradata_size > 0){
+        ps->extradata = av_mallocz(ps->extradata_size + FF_INPUT_BUFFER_PADDING_SIZE);
+        if(!ps->extradata){
+            return AVERROR(ENOMEM);
+        }
+        for(i=0; i<ps->extradata_size; ++i){
+            if(fscanf(fp, "%2x", &byte) != 1){
+                return -1;
+            }
+            ps->extradata[i] = byte;
+        }
+    }
+    return 0;
+}
+
+//only called once every record has parsed, the context is left as it was on a miss
+static void probe_cache_apply_stream(AVStream *st, ProbeCacheStream *ps){
+    AVCodecContext *c = st->codec;
+
+    st->time_base = ps->time_base;
+    st->duration = ps->duration;
+    st->start_time = ps->start_time;
+    st->nb_frames = ps->nb_frames;
+    st->avg_frame_rate = ps->avg_frame_rate;
+    st->r_frame_rate = ps->r_frame_rate;
+    st->sample_aspect_ratio = ps->sample_aspect_ratio;
+
+    c->time_base = ps->codec_time_base;
+    c->ticks_per_frame = ps->ticks_per_frame;
+    c->codec_tag = ps->codec_tag;
+    c->bit_rate = ps->bit_rate;
+    c->profile = ps->profile;
+    c->level = ps->level;
+    c->bits_per_coded_sample = ps->bits_per_coded_sample;
+    c->bits_per_raw_sample = ps->bits_per_raw_sample;
+
+    c->width = c->coded_width = ps->width;
+    c->height = c->coded_height = ps->height;
+    c->pix_fmt = ps->pix_fmt;
+    c->sample_aspect_ratio = ps->codec_sample_aspect_ratio;
+    c->has_b_frames = ps->has_b_frames;
+    c->field_order = ps->field_order;
+    c->color_range = ps->color_range;
+    c->color_primaries = ps->color_primaries;
+    c->color_trc = ps->color_trc;
+    c->colorspace = ps->colorspace;
+    c->chroma_sample_location = ps->chroma_sample_location;
+
+    c->sample_rate = ps->sample_rate;
+    c->channels = ps->channels;
+    c->channel_layout = ps->channel_layout;
+    c->sample_fmt = ps->sample_fmt;
+    c->frame_size = ps->frame_size;
+    c->block_align = ps->block_align;
+    c->initial_padding = ps->initial_padding;
+    c->seek_preroll = ps->seek_preroll;
+
+    //the demuxer may have read it from the header already
+    if(ps->extradata && !c->extradata){
+        c->extradata = ps->extradata;
+        c->extradata_size = ps->extradata_size;
+        ps->extradata = NULL;
+    }
+}
+
+int probe_cache_load(AVFormatContext *ic, const char *filename){
+    char path[1024 + sizeof(PROBE_CACHE_SUFFIX)];
+    char magic[64], format[64];
+    int64_t size, mtime, cached_size, cached_mtime, duration, start_time;
+    unsigned int nb_streams, i;
+    int bit_rate;
+    ProbeCacheStream *streams = NULL;
+    FILE *fp;
+    int ret = -1;
+
+    if(input_io_file_identity(filename, &size, &mtime) < 0){
+        return -1;
+    }
+    probe_cache_path(filename, path, sizeof(path));
+    fp = fopen(path, "r");
+    if(!fp){
+        return -1;
+    }
+    if(!fgets(magic, sizeof(magic), fp) || strncmp(magic, PROBE_CACHE_MAGIC, strlen(PROBE_CACHE_MAGIC))
+       || fscanf(fp, "size %"SCNd64" mtime %"SCNd64" format %63s streams %u", &cached_size, &cached_mtime, format, &nb_streams) != 4
+       || cached_size != size || cached_mtime != mtime || strcmp(format, ic->iformat->name) || nb_streams != ic->nb_streams){
+        goto end; //stale, or streams found only by probing
+    }
+    if(fscanf(fp, " duration %"SCNd64" start_time %"SCNd64" bit_rate %d\n", &duration, &start_time, &bit_rate) != 3){
+        goto end;
+    }
+    streams = av_mallocz_array(FFMAX(nb_streams, 1), sizeof(*streams));
+    if(!streams){
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for(i=0; i<nb_streams; ++i){
+        if((ret = probe_cache_read_stream(fp, ic, i, &streams[i])) < 0){
+            goto end;
+        }
+    }
+
+    ic->duration = duration;
+    ic->start_time = start_time;
+    ic->bit_rate = bit_rate;
+    for(i=0; i<nb_streams; ++i){
+        probe_cache_apply_stream(ic->streams[i], &streams[i]);
+    }
+    ret = 0;
+end:
+    fclose(fp);
+    if(streams){
+        for(i=0; i<nb_streams; ++i){
+            av_free(streams[i].extradata);
+        }
+        av_free(streams);
+    }
+    if(ret < 0){
+        fprintf(stderr, "probe_cache: miss for %s.\n", filename);
+    }
+    return ret;
+}
+
+void probe_cache_save(AVFormatContext *ic, const char *filename){
+    char path[1024 + sizeof(PROBE_CACHE_SUFFIX)];
+    int64_t size, mtime;
+    AVStream *st;
+    AVCodecContext *c;
+    unsigned int i;
+    int j;
+    FILE *fp;
+
+    if(input_io_file_identity(filename, &size, &mtime) < 0){
+        return;
+    }
+    probe_cache_path(filename, path, sizeof(path));
+    fp = fopen(path, "w");
+    if(!fp){
+        fprintf(stderr, "probe_cache: could not write %s.\n", path);
+        return;
+    }
+    fprintf(fp, "%s\n", PROBE_CACHE_MAGIC);
+    fprintf(fp, "size %"PRId64" mtime %"PRId64" format %s streams %u duration %"PRId64" start_time %"PRId64" bit_rate %d\n",
+            size, mtime, ic->iformat->name, ic->nb_streams, ic->duration, ic->start_time, ic->bit_rate);
+    for(i=0; i<ic->nb_streams; ++i){
+        st = ic->streams[i];
+        c = st->codec;
+        fprintf(fp, "stream %u type %d codec %d tb %d %d duration %"PRId64" start %"PRId64" nb_frames %"PRId64
+                    " avg_fr %d %d r_fr %d %d sar %d %d\n",
+                i, c->codec_type, c->codec_id, st->time_base.num, st->time_base.den, st->duration, st->start_time, st->nb_frames,
+                st->avg_frame_rate.num, st->avg_frame_rate.den, st->r_frame_rate.num, st->r_frame_rate.den,
+                st->sample_aspect_ratio.num, st->sample_aspect_ratio.den);
+        fprintf(fp, "codec tb %d %d ticks %d tag %u bit_rate %d profile %d level %d bits %d %d\n",
+                c->time_base.num, c->time_base.den, c->ticks_per_frame, c->codec_tag, c->bit_rate, c->profile, c->level,
+                c->bits_per_coded_sample, c->bits_per_raw_sample);
+        fprintf(fp, "video %d %d %d sar %d %d delay %d field %d color %d %d %d %d %d\n",
+                c->width, c->height, c->pix_fmt, c->sample_aspect_ratio.num, c->sample_aspect_ratio.den,
+                c->has_b_frames, c->field_order,
+                c->color_range, c->color_primaries, c->color_trc, c->colorspace, c->chroma_sample_location);
+        fprintf(fp, "audio %d %d %"PRIu64" %d %d block_align %d padding %d preroll %d\n",
+                c->sample_rate, c->channels, c->channel_layout, c->sample_fmt, c->frame_size,
+                c->block_align, c->initial_padding, c->seek_preroll);
+        fprintf(fp, "extradata %d ", c->extradata ? c->extradata_size : 0);
+        for(j=0; c->extradata && j<c->extradata_size; ++j){
+            fprintf(fp, "%02x", c->extradata[j]);
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+}
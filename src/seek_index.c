@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL.h>
+#include "libavutil/avstring.h"
+#include "libavutil/time.h"
+
+#include "input_io.h"
+#include "seek_index.h"
+
+#define SEEK_INDEX_MAGIC "silly_player seek index 1"
+
+typedef struct SeekIndexEntry{
+    int64_t pos;
+    int64_t timestamp; //time_base of the indexed stream
+    int size;
+}SeekIndexEntry;
+
+struct SeekIndex{
+    char filename[1024];
+    char path[1024 + sizeof(SEEK_INDEX_SUFFIX)]; //of the sidecar
+    int64_t file_size, mtime;
+
+    int stream_index; //the indexed stream
+    int byte_seek; //seek by byte offset, the demuxer allows it
+    SeekIndexEntry *entries; //sorted by timestamp
+    int nb_entries, capacity;
+
+    SDL_Thread *scan_tid;
+    SDL_atomic_t scan_done; //the scan is over, 'entries' may be merged
+    SDL_atomic_t abort_req;
+    int merged;
+};
+
+static int seek_index_append(SeekIndex *si, int64_t pos, int64_t timestamp, int size){
+    SeekIndexEntry *entries;
+
+    if(si->nb_entries == si->capacity){
+        si->capacity = si->capacity ? si->capacity * 2 : 1024;
+        entries = av_realloc_array(si->entries, si->capacity, sizeof(SeekIndexEntry));
+        if(!entries){
+            return AVERROR(ENOMEM);
+        }
+        si->entries = entries;
+    }
+    si->entries[si->nb_entries].pos = pos;
+    si->entries[si->nb_entries].timestamp = timestamp;
+    si->entries[si->nb_entries].size = size;
+    si->nb_entries++;
+    return 0;
+}
+
+//add the entries to the index of the stream, where the generic seeking code looks them up
+static void seek_index_merge(SeekIndex *si, AVFormatContext *ic){
+    AVStream *st = ic->streams[si->stream_index];
+    int i;
+
+    for(i=0; i<si->nb_entries; ++i){
+        av_add_index_entry(st, si->entries[i].pos, si->entries[i].timestamp, si->entries[i].size, 0, AVINDEX_KEYFRAME);
+    }
+    si->merged = 1;
+    fprintf(stderr, "seek_index: %d keyframes of stream[%d] indexed.\n", si->nb_entries, si->stream_index);
+}
+
+static int seek_index_load(SeekIndex *si){
+    FILE *fp = fopen(si->path, "r");
+    char magic[64];
+    int64_t file_size, mtime, pos, timestamp;
+    int stream_index, byte_seek, nb_entries, size, i;
+
+    if(!fp){
+        return -1;
+    }
+    if(!fgets(magic, sizeof(magic), fp) || strncmp(magic, SEEK_INDEX_MAGIC, strlen(SEEK_INDEX_MAGIC))
+       || fscanf(fp, "size %"SCNd64" mtime %"SCNd64" stream %d byte_seek %d entries %d\n",
+                 &file_size, &mtime, &stream_index, &byte_seek, &nb_entries) != 5
+       || file_size != si->file_size || mtime != si->mtime || stream_index != si->stream_index){
+        fclose(fp);
+        return -1; //stale or foreign
+    }
+    for(i=0; i<nb_entries; ++i){
+        if(fscanf(fp, "%"SCNd64" %"SCNd64" %d\n", &pos, &timestamp, &size) != 3 || seek_index_append(si, pos, timestamp, size) < 0){
+            fclose(fp);
+            si->nb_entries = 0;
+            return -1;
+        }
+    }
+    fclose(fp);
+    si->byte_seek = byte_seek;
+    return 0;
+}
+
+static void seek_index_save(SeekIndex *si){
+    FILE *fp = fopen(si->path, "w");
+    int i;
+
+    if(!fp){
+        fprintf(stderr, "seek_index: could not write %s.\n", si->path);
+        return;
+    }
+    fprintf(fp, "%s\n", SEEK_INDEX_MAGIC);
+    fprintf(fp, "size %"PRId64" mtime %"PRId64" stream %d byte_seek %d entries %d\n",
+            si->file_size, si->mtime, si->stream_index, si->byte_seek, si->nb_entries);
+    for(i=0; i<si->nb_entries; ++i){
+        fprintf(fp, "%"PRId64" %"PRId64" %d\n", si->entries[i].pos, si->entries[i].timestamp, si->entries[i].size);
+    }
+    fclose(fp);
+}
+
+//a native index covers the whole stream already, nothing to do for us
+static int seek_index_native(AVFormatContext *ic, AVStream *st){
+    int64_t last;
+
+    if(st->nb_index_entries < 2){
+        return 0;
+    }
+    if(st->duration == AV_NOPTS_VALUE){
+        return 1;
+    }
+    last = st->index_entries[st->nb_index_entries - 1].timestamp;
+    if(st->start_time != AV_NOPTS_VALUE){
+        last -= st->start_time;
+    }
+    return last >= st->duration * 9 / 10;
+}
+
+//read the whole file through a context of its own, record the keyframes of the indexed stream
+static int seek_index_scan_thread(void *arg){
+    SeekIndex *si = (SeekIndex *)arg;
+    AVFormatContext *ic = NULL;
+    AVPacket pkt;
+    AVStream *st;
+    int64_t ts, interval, last_ts = AV_NOPTS_VALUE;
+    int64_t scan_start = av_gettime();
+    unsigned int i;
+
+    if(avformat_open_input(&ic, si->filename, NULL, NULL) != 0){
+        goto end;
+    }
+    if(si->stream_index >= (int)ic->nb_streams){
+        goto end;
+    }
+    for(i=0; i<ic->nb_streams; ++i){
+        ic->streams[i]->discard = (int)i == si->stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    st = ic->streams[si->stream_index];
+    interval = (int64_t)(SEEK_INDEX_INTERVAL / av_q2d(st->time_base));
+
+    av_init_packet(&pkt);
+    while(!SDL_AtomicGet(&si->abort_req) && av_read_frame(ic, &pkt) >= 0){
+        ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+        if(pkt.stream_index == si->stream_index && (pkt.flags & AV_PKT_FLAG_KEY) && pkt.pos >= 0 && ts != AV_NOPTS_VALUE
+           && (last_ts == AV_NOPTS_VALUE || ts - last_ts >= interval)){
+            if(seek_index_append(si, pkt.pos, ts, pkt.size) < 0){
+                av_packet_unref(&pkt);
+                break;
+            }
+            last_ts = ts;
+        }
+        av_packet_unref(&pkt);
+    }
+
+    if(!SDL_AtomicGet(&si->abort_req) && si->nb_entries > 0){
+        fprintf(stderr, "seek_index: file scanned in %"PRId64" ms.\n", (av_gettime() - scan_start) / 1000);
+        seek_index_save(si);
+    }
+end:
+    avformat_close_input(&ic);
+    SDL_AtomicSet(&si->scan_done, 1);
+    return 0;
+}
+
+SeekIndex *seek_index_open(AVFormatContext *ic, const char *filename){
+    SeekIndex *si;
+    int stream_index;
+
+    stream_index = av_find_default_stream_index(ic);
+    if(stream_index < 0 || seek_index_native(ic, ic->streams[stream_index])){
+        return NULL;
+    }
+    si = av_mallocz(sizeof(SeekIndex));
+    if(!si){
+        return NULL;
+    }
+    if(input_io_file_identity(filename, &si->file_size, &si->mtime) < 0){
+        av_free(si);
+        return NULL;
+    }
+    av_strlcpy(si->filename, filename, sizeof(si->filename));
+    snprintf(si->path, sizeof(si->path), "%s%s", input_io_local_path(filename), SEEK_INDEX_SUFFIX);
+    si->stream_index = stream_index;
+    si->byte_seek = !(ic->iformat->flags & AVFMT_NO_BYTE_SEEK);
+
+    if(seek_index_load(si) == 0){
+        seek_index_merge(si, ic);
+        SDL_AtomicSet(&si->scan_done, 1);
+        return si;
+    }
+
+    si->scan_tid = SDL_CreateThread(seek_index_scan_thread, "SEEK_INDEX_THREAD", si);
+    if(!si->scan_tid){
+        av_free(si);
+        return NULL;
+    }
+    return si;
+}
+
+int seek_index_update(SeekIndex *si, AVFormatContext *ic){
+    if(!si || si->merged || !SDL_AtomicGet(&si->scan_done)){
+        return 0;
+    }
+    seek_index_merge(si, ic);
+    return 1;
+}
+
+int seek_index_seek(SeekIndex *si, AVFormatContext *ic, int64_t ts, int flags){
+    AVStream *st;
+    int64_t target;
+    int index;
+
+    if(ic->start_time != AV_NOPTS_VALUE){
+        ts += ic->start_time;
+    }
+    if(si && si->merged && si->byte_seek){
+        st = ic->streams[si->stream_index];
+        target = av_rescale_q(ts, AV_TIME_BASE_Q, st->time_base);
+        index = av_index_search_timestamp(st, target, flags & AVSEEK_FLAG_BACKWARD);
+        if(index >= 0){
+            return av_seek_frame(ic, si->stream_index, st->index_entries[index].pos, AVSEEK_FLAG_BYTE);
+        }
+    }
+    //the demuxer seeks with its own index (or the one we merged), to a keyframe anyway
+    return av_seek_frame(ic, -1, ts, flags & AVSEEK_FLAG_BACKWARD);
+}
+
+void seek_index_close(SeekIndex **si){
+    if(!*si){
+        return;
+    }
+    SDL_AtomicSet(&(*si)->abort_req, 1);
+    if((*si)->scan_tid){
+        SDL_WaitThread((*si)->scan_tid, NULL);
+    }
+    av_free((*si)->entries);
+    av_freep(si);
+}
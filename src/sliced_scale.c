@@ -0,0 +1,175 @@
+#include <SDL.h>
+#include <libswscale/swscale.h>
+#include "libavutil/pixdesc.h"
+
+#include "sliced_scale.h"
+
+typedef struct SliceWorker{
+    SlicedScale *ss;
+    int index; //band converted
+    SDL_Thread *thread;
+    struct SwsContext *sws_ctx; //used by this worker only
+}SliceWorker;
+
+struct SlicedScale{
+    SliceWorker workers[SLICED_SCALE_MAX_THREADS]; //workers[0] is the calling thread
+    int nb_workers;
+
+    SDL_mutex *mutex;
+    SDL_cond *cond_job;
+    SDL_cond *cond_done;
+    int job; //bumped for every picture
+    int pending; //bands still being converted
+    int error; //a band had no context
+    int quit;
+
+    //the picture being converted
+    const AVFrame *src;
+    AVFrame *dst;
+    int nb_bands;
+    int band_h;
+};
+
+//convert the rows of band 'w->index', a picture of its own to the worker's context
+static void slice_convert(SliceWorker *w){
+    SlicedScale *ss = w->ss;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ss->src->format);
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int y = w->index * ss->band_h;
+    int h = FFMIN(ss->band_h, ss->src->height - y);
+    int i;
+
+    w->sws_ctx = sws_getCachedContext(w->sws_ctx, ss->src->width, h, ss->src->format,
+                                      ss->dst->width, h, AV_PIX_FMT_YUV420P,
+                                      SWS_BICUBIC, NULL, NULL, NULL);
+    if(!w->sws_ctx){
+        SDL_LockMutex(ss->mutex);
+        ss->error = 1;
+        SDL_UnlockMutex(ss->mutex);
+        return;
+    }
+    //planes 1 & 2 hold the chroma, halved vertically on both sides
+    for(i=0; i<4; ++i){
+        src[i] = ss->src->data[i] ? ss->src->data[i] + (y >> (i == 1 || i == 2 ? desc->log2_chroma_h : 0)) * ss->src->linesize[i] : NULL;
+        dst[i] = ss->dst->data[i] ? ss->dst->data[i] + (y >> (i == 1 || i == 2 ? 1 : 0)) * ss->dst->linesize[i] : NULL;
+    }
+    sws_scale(w->sws_ctx, src, ss->src->linesize, 0, h, dst, ss->dst->linesize);
+}
+
+static int slice_worker_thread(void *arg){
+    SliceWorker *w = arg;
+    SlicedScale *ss = w->ss;
+    int job = 0;
+
+    SDL_LockMutex(ss->mutex);
+    for(;;){
+        while(!ss->quit && ss->job == job){
+            SDL_CondWait(ss->cond_job, ss->mutex);
+        }
+        if(ss->quit){
+            break;
+        }
+        job = ss->job;
+        if(w->index >= ss->nb_bands){
+            continue;
+        }
+        SDL_UnlockMutex(ss->mutex);
+
+        slice_convert(w);
+
+        SDL_LockMutex(ss->mutex);
+        if(--ss->pending == 0){
+            SDL_CondSignal(ss->cond_done);
+        }
+    }
+    SDL_UnlockMutex(ss->mutex);
+    return 0;
+}
+
+SlicedScale *sliced_scale_create(int nb_threads){
+    SlicedScale *ss = av_mallocz(sizeof(SlicedScale));
+    int i;
+
+    if(!ss){
+        return NULL;
+    }
+    if(nb_threads <= 0){
+        nb_threads = SDL_GetCPUCount();
+    }
+    ss->nb_workers = av_clip(nb_threads, 1, SLICED_SCALE_MAX_THREADS);
+    ss->mutex = SDL_CreateMutex();
+    ss->cond_job = SDL_CreateCond();
+    ss->cond_done = SDL_CreateCond();
+
+    for(i=0; i<ss->nb_workers; ++i){
+        ss->workers[i].ss = ss;
+        ss->workers[i].index = i;
+        if(i > 0){
+            ss->workers[i].thread = SDL_CreateThread(slice_worker_thread, "sliced_scale", &ss->workers[i]);
+            if(!ss->workers[i].thread){
+                ss->nb_workers = i;
+                break;
+            }
+        }
+    }
+    return ss;
+}
+
+void sliced_scale_destroy(SlicedScale **ss){
+    int i;
+
+    if(!*ss){
+        return;
+    }
+    SDL_LockMutex((*ss)->mutex);
+    (*ss)->quit = 1;
+    SDL_CondBroadcast((*ss)->cond_job);
+    SDL_UnlockMutex((*ss)->mutex);
+
+    for(i=0; i<(*ss)->nb_workers; ++i){
+        if((*ss)->workers[i].thread){
+            SDL_WaitThread((*ss)->workers[i].thread, NULL);
+        }
+        sws_freeContext((*ss)->workers[i].sws_ctx);
+    }
+    SDL_DestroyCond((*ss)->cond_done);
+    SDL_DestroyCond((*ss)->cond_job);
+    SDL_DestroyMutex((*ss)->mutex);
+    av_freep(ss);
+}
+
+int sliced_scale_frame(SlicedScale *ss, const AVFrame *src, AVFrame *dst){
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->format);
+    int rows;
+
+    //vertical chroma resampling or scaling would cross the band edges
+    if(!ss || ss->nb_workers < 2 || !desc || dst->format != AV_PIX_FMT_YUV420P
+       || src->width != dst->width || src->height != dst->height
+       || desc->log2_chroma_h != 1
+       || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))){
+        return AVERROR(ENOSYS);
+    }
+    rows = (src->height + ss->nb_workers - 1) / ss->nb_workers;
+    rows = FFALIGN(rows, SLICED_SCALE_ALIGN);
+
+    SDL_LockMutex(ss->mutex);
+    ss->src = src;
+    ss->dst = dst;
+    ss->band_h = rows;
+    ss->nb_bands = (src->height + rows - 1) / rows;
+    ss->pending = ss->nb_bands - 1;
+    ss->error = 0;
+    ss->job++;
+    SDL_CondBroadcast(ss->cond_job);
+    SDL_UnlockMutex(ss->mutex);
+
+    slice_convert(&ss->workers[0]);
+
+    SDL_LockMutex(ss->mutex);
+    while(ss->pending > 0){
+        SDL_CondWait(ss->cond_done, ss->mutex);
+    }
+    SDL_UnlockMutex(ss->mutex);
+    return ss->error ? AVERROR(ENOMEM) : 0;
+}
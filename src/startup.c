@@ -0,0 +1,32 @@
+#include "libavutil/time.h"
+
+#include "startup.h"
+
+static const char *phase_names[STARTUP_NB] = {
+    "begin", "open", "probe", "decoders", "first_packet", "first_frame",
+};
+
+void startup_mark(StartupTimes *st, int phase){
+    if(!SDL_AtomicCAS(&st->marked[phase], 0, 1)){
+        return;
+    }
+    st->t[phase] = av_gettime();
+    if(phase == STARTUP_FIRST_FRAME){
+        startup_dump(st, stderr);
+    }
+}
+
+void startup_dump(StartupTimes *st, FILE *fp){
+    int64_t last = st->t[STARTUP_BEGIN];
+    int i;
+
+    fprintf(fp, "{\"startup\":\"ms\"");
+    for(i=STARTUP_BEGIN+1; i<STARTUP_NB; ++i){
+        if(!SDL_AtomicGet(&st->marked[i])){
+            continue;
+        }
+        fprintf(fp, ", \"%s\":%.1f", phase_names[i], (st->t[i] - last) / 1000.0);
+        last = st->t[i];
+    }
+    fprintf(fp, ", \"total\":%.1f}\n", (last - st->t[STARTUP_BEGIN]) / 1000.0);
+}
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "input_io.h"
+#include "uring_io.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#if HAVE_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "libavutil/time.h"
+
+enum{
+    BLOCK_IDLE, //beyond the end of file
+    BLOCK_INFLIGHT,
+    BLOCK_READY,
+};
+
+//blocks[(head+i) % URING_IO_DEPTH] covers the file from blocks[head].offset + i*URING_IO_BLOCK on
+typedef struct UringBlock{
+    uint8_t *data;
+    int64_t offset;
+    int len; //bytes read so far, or AVERROR
+    int state;
+    struct iovec iov;
+}UringBlock;
+
+typedef struct UringIO{
+    int fd;
+    int64_t file_size;
+    int64_t pos; //reading position
+
+    int ring_fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+
+    UringBlock blocks[URING_IO_DEPTH];
+    int head;
+    AVIOInterruptCB int_cb;
+
+    UringIOStats stats;
+}UringIO;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_io_setup(UringIO *u){
+    struct io_uring_params p;
+    uint8_t *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = sys_io_uring_setup(URING_IO_DEPTH, &p);
+    if(u->ring_fd < 0){
+        return AVERROR(errno);
+    }
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if(u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED || u->sqes == MAP_FAILED){
+        return AVERROR(ENOMEM);
+    }
+
+    sq = (uint8_t *)u->sq_ring;
+    u->sq_head = (unsigned *)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + p.sq_off.array);
+    cq = (uint8_t *)u->cq_ring;
+    u->cq_head = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void uring_io_teardown(UringIO *u){
+    if(u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+    if(u->cq_ring && u->cq_ring != MAP_FAILED) munmap(u->cq_ring, u->cq_ring_size);
+    if(u->sq_ring && u->sq_ring != MAP_FAILED) munmap(u->sq_ring, u->sq_ring_size);
+    if(u->ring_fd >= 0) close(u->ring_fd);
+}
+
+//queue a read of [blk->offset + blk->len, blk->offset + URING_IO_BLOCK) into the block
+static int uring_io_submit(UringIO *u, int index){
+    UringBlock *blk = &u->blocks[index];
+    struct io_uring_sqe *sqe;
+    unsigned tail;
+    int ret;
+
+    tail = *u->sq_tail;
+    sqe = &u->sqes[tail & *u->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    blk->iov.iov_base = blk->data + blk->len;
+    blk->iov.iov_len = URING_IO_BLOCK - blk->len;
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = u->fd;
+    sqe->addr = (unsigned long)&blk->iov;
+    sqe->len = 1;
+    sqe->off = blk->offset + blk->len;
+    sqe->user_data = index;
+    u->sq_array[tail & *u->sq_mask] = tail & *u->sq_mask;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    blk->state = BLOCK_INFLIGHT;
+    u->stats.inflight++;
+    u->stats.nb_submits++;
+    do{
+        ret = sys_io_uring_enter(u->ring_fd, 1, 0, 0);
+    }while(ret < 0 && errno == EINTR);
+    if(ret < 1){
+        //not taken by the kernel, no completion will come: withdraw the entry & fail the block,
+        //so that neither the reads nor uring_io_free() wait for it
+        ret = ret < 0 ? AVERROR(errno) : AVERROR(EAGAIN);
+        __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+        u->stats.inflight--;
+        u->stats.nb_submits--;
+        blk->len = ret;
+        blk->state = BLOCK_READY;
+        return ret;
+    }
+    return 0;
+}
+
+//(re)start a block at 'offset', nothing to read past the end of file
+static int uring_io_start(UringIO *u, int index, int64_t offset){
+    UringBlock *blk = &u->blocks[index];
+
+    blk->offset = offset;
+    blk->len = 0;
+    if(offset >= u->file_size){
+        blk->state = BLOCK_IDLE;
+        return 0;
+    }
+    return uring_io_submit(u, index);
+}
+
+//handle the completions available, waiting for at least one if 'wait' is set
+static int uring_io_reap(UringIO *u, int wait){
+    struct io_uring_cqe *cqe;
+    UringBlock *blk;
+    unsigned head;
+    int ret;
+
+    if(wait){
+        do{
+            ret = sys_io_uring_enter(u->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        }while(ret < 0 && errno == EINTR);
+        if(ret < 0){
+            return AVERROR(errno);
+        }
+    }
+
+    head = *u->cq_head;
+    while(head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)){
+        cqe = &u->cqes[head & *u->cq_mask];
+        blk = &u->blocks[cqe->user_data];
+        u->stats.inflight--;
+        if(cqe->res < 0){
+            blk->len = AVERROR(-cqe->res);
+            blk->state = BLOCK_READY;
+        }else{
+            blk->len += cqe->res;
+            //short read in the middle of the file, read the rest of the block
+            if(cqe->res > 0 && blk->len < URING_IO_BLOCK && blk->offset + blk->len < u->file_size){
+                head++;
+                __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+                if((ret = uring_io_submit(u, (int)cqe->user_data)) < 0){
+                    return ret;
+                }
+                continue;
+            }
+            blk->state = BLOCK_READY;
+        }
+        head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int uring_io_wait_block(UringIO *u, UringBlock *blk){
+    int64_t wait_start;
+    int ret = 0;
+
+    if(blk->state != BLOCK_INFLIGHT){
+        return 0;
+    }
+    if((ret = uring_io_reap(u, 0)) < 0 || blk->state != BLOCK_INFLIGHT){
+        return ret;
+    }
+    if(input_io_interrupted(&u->int_cb)){
+        return AVERROR_EXIT;
+    }
+    wait_start = av_gettime();
+    u->stats.nb_waits++;
+    while(blk->state == BLOCK_INFLIGHT && ret >= 0){
+        ret = uring_io_reap(u, 1);
+    }
+    u->stats.wait_time += av_gettime() - wait_start;
+    return ret;
+}
+
+//drop everything & read the file from 'pos' on, blocks start at a multiple of URING_IO_BLOCK
+static int uring_io_restart(UringIO *u, int64_t pos){
+    int64_t base = pos & ~(int64_t)(URING_IO_BLOCK - 1);
+    int i, ret;
+
+    while(u->stats.inflight > 0){
+        if((ret = uring_io_reap(u, 1)) < 0){
+            return ret;
+        }
+    }
+    u->head = 0;
+    u->pos = pos;
+    for(i=0; i<URING_IO_DEPTH; ++i){
+        if((ret = uring_io_start(u, i, base + (int64_t)i * URING_IO_BLOCK)) < 0){
+            return ret;
+        }
+    }
+    return 0;
+}
+
+//the head block is consumed, reuse it for the block after the last one
+static int uring_io_advance(UringIO *u){
+    UringBlock *blk = &u->blocks[u->head];
+    int64_t next = blk->offset + (int64_t)URING_IO_DEPTH * URING_IO_BLOCK;
+    int ret;
+
+    if((ret = uring_io_wait_block(u, blk)) < 0){
+        return ret;
+    }
+    u->head = (u->head + 1) % URING_IO_DEPTH;
+    return uring_io_start(u, (int)(blk - u->blocks), next);
+}
+
+static int uring_io_read(void *opaque, uint8_t *buf, int buf_size){
+    UringIO *u = (UringIO *)opaque;
+    UringBlock *blk;
+    int off, len, ret;
+
+    u->stats.nb_reads++;
+    u->stats.inflight_sum += u->stats.inflight;
+    for(;;){
+        blk = &u->blocks[u->head];
+        if((ret = uring_io_wait_block(u, blk)) < 0){
+            return ret;
+        }
+        if(blk->state == BLOCK_IDLE){
+            return AVERROR_EOF;
+        }
+        if(blk->len < 0){
+            return blk->len;
+        }
+        off = (int)(u->pos - blk->offset);
+        if(off < blk->len){
+            len = FFMIN(buf_size, blk->len - off);
+            memcpy(buf, blk->data + off, len);
+            u->pos += len;
+            return len;
+        }
+        if(blk->len < URING_IO_BLOCK){
+            return AVERROR_EOF; //short block: end of file
+        }
+        if((ret = uring_io_advance(u)) < 0){
+            return ret;
+        }
+    }
+}
+
+static int64_t uring_io_seek(void *opaque, int64_t offset, int whence){
+    UringIO *u = (UringIO *)opaque;
+    int64_t pos, base;
+    int ret;
+
+    switch(whence & ~AVSEEK_FORCE){
+    case AVSEEK_SIZE:
+        return u->file_size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = u->pos + offset;
+        break;
+    case SEEK_END:
+        pos = u->file_size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if(pos < 0){
+        return AVERROR(EINVAL);
+    }
+
+    base = u->blocks[u->head].offset;
+    if(pos >= base && pos < base + (int64_t)URING_IO_DEPTH * URING_IO_BLOCK){
+        //within the blocks already queued, recycle the ones before 'pos'
+        while(pos >= u->blocks[u->head].offset + URING_IO_BLOCK){
+            if((ret = uring_io_advance(u)) < 0){
+                return ret;
+            }
+        }
+        u->pos = pos;
+    }else if((ret = uring_io_restart(u, pos)) < 0){
+        return ret;
+    }
+    return pos;
+}
+
+static void uring_io_free(UringIO *u){
+    int i;
+
+    while(u->stats.inflight > 0 && uring_io_reap(u, 1) >= 0)
+        ;
+    uring_io_teardown(u);
+    for(i=0; i<URING_IO_DEPTH; ++i){
+        av_free(u->blocks[i].data);
+    }
+    if(u->fd >= 0) close(u->fd);
+    av_free(u);
+}
+
+AVIOContext *uring_io_open(const char *filename, const AVIOInterruptCB *int_cb){
+    const char *path = input_io_local_path(filename);
+    struct stat st;
+    UringIO *u;
+    uint8_t *buffer = NULL;
+    AVIOContext *pb = NULL;
+    int i, ret;
+
+    if(!path){
+        return NULL;
+    }
+    u = av_mallocz(sizeof(UringIO));
+    if(!u){
+        return NULL;
+    }
+    u->ring_fd = -1;
+    if(int_cb){
+        u->int_cb = *int_cb;
+    }
+    u->fd = open(path, O_RDONLY);
+    if(u->fd < 0 || fstat(u->fd, &st) < 0 || !S_ISREG(st.st_mode)){
+        goto fail;
+    }
+    u->file_size = st.st_size;
+    if((ret = uring_io_setup(u)) < 0){
+        fprintf(stderr, "uring_io: io_uring unavailable (%s), fall back to file protocol.\n", av_err2str(ret));
+        goto fail;
+    }
+    for(i=0; i<URING_IO_DEPTH; ++i){
+        if(!(u->blocks[i].data = av_malloc(URING_IO_BLOCK))){
+            goto fail;
+        }
+    }
+    if(uring_io_restart(u, 0) < 0){
+        goto fail;
+    }
+
+    buffer = av_malloc(URING_IO_BUFFER_SIZE);
+    pb = buffer ? avio_alloc_context(buffer, URING_IO_BUFFER_SIZE, 0, u, uring_io_read, NULL, uring_io_seek) : NULL;
+    if(!pb){
+        goto fail;
+    }
+    return pb;
+
+fail:
+    av_free(buffer);
+    uring_io_free(u);
+    return NULL;
+}
+
+void uring_io_close(AVIOContext **pb){
+    if(!*pb){
+        return;
+    }
+    uring_io_free((UringIO *)(*pb)->opaque);
+    av_freep(&(*pb)->buffer);
+    av_freep(pb);
+}
+
+void uring_io_get_stats(AVIOContext *pb, UringIOStats *st){
+    *st = ((UringIO *)pb->opaque)->stats;
+}
+
+#else //!HAVE_IO_URING
+
+AVIOContext *uring_io_open(const char *filename, const AVIOInterruptCB *int_cb){
+    if(input_io_local_path(filename)){
+        fprintf(stderr, "uring_io: io_uring unsupported on this platform, fall back to file protocol.\n");
+    }
+    return NULL;
+}
+
+void uring_io_close(AVIOContext **pb){
+}
+
+void uring_io_get_stats(AVIOContext *pb, UringIOStats *st){
+    memset(st, 0, sizeof(*st));
+}
+
+#endif
@@ -13,10 +13,12 @@ extern "C"
 #include <libswscale/swscale.h>
 */
 #include <SDL.h>
-
+#include "libavutil/time.h"
 
 #include "video.h"
 #include "player.h"
+#include "parse.h"
+#include "audio.h"
 
 #ifdef __cplusplus
 };
@@ -29,6 +31,7 @@ static SDL_mutex *sdlWinMutex;
 
 static SDL_Renderer *sdlRen;
 static SDL_Texture *sdlTex;
+static int tex_width, tex_height;
 
 int video_init(VideoState *is){
     sdlWin = SDL_CreateWindow("silly player", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
@@ -40,6 +43,20 @@ int video_init(VideoState *is){
     }
     sdlRen = SDL_CreateRenderer(sdlWin, -1, 0);
     sdlTex = SDL_CreateTexture(sdlRen, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING,is->video_ctx->width,is->video_ctx->height);
+    tex_width = is->video_ctx->width;
+    tex_height = is->video_ctx->height;
+}
+
+/* how long a decoded frame lasts, in seconds */
+static double frame_duration(VideoState *is, AVFrame *frame)
+{
+    int64_t duration = av_frame_get_pkt_duration(frame);
+
+    if(duration > 0)
+        return duration * av_q2d(is->video_st->time_base);
+    if(is->video_st->avg_frame_rate.num > 0)
+        return 1.0 / av_q2d(is->video_st->avg_frame_rate);
+    return av_q2d(is->video_ctx->time_base) * is->video_ctx->ticks_per_frame;
 }
 
 static double synchronize_video(VideoState *is, AVFrame *src_frame, double pts)
@@ -56,37 +73,124 @@ static double synchronize_video(VideoState *is, AVFrame *src_frame, double pts)
         /* if we aren't given a pts, set it to the clock */
         pts = is->video_clock;
     }
-    /* update the video clock */
-    frame_delay = av_q2d(is->video_ctx->time_base);
+    /* update the video clock, by the duration of the frame (ticks_per_frame counted) */
+    frame_delay = frame_duration(is, src_frame);
     /* if we are repeating a frame, adjust clock accordingly */
     frame_delay += src_frame->repeat_pict * (frame_delay * 0.5);
     is->video_clock += frame_delay;
     return pts;
 }
 
-static int queue_picture(VideoState *is, AVFrame *pFrame, double pts){
-    VideoPicture *vp; //exactly the same as is->pictq
+static void set_late_level(VideoState *is, int level)
+{
+    if(level == is->late_level)
+        return;
+    is->late_level = level;
+    is->video_ctx->skip_frame = level >= 1 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    is->video_ctx->skip_loop_filter = level >= 2 ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    fprintf(stderr, "video late: skipping level %d\n", level);
+}
 
-    //wait for finishing displaying the last frame
+/* whether a frame of 'pts' from videoq generation 'serial' is too late to be worth converting,
+ * escalating the skipping under sustained overload & stepping it back once frames come in time again.
+ * the audio clock is trusted only on the same generation, out of trick play & within AV_NOSYNC_THRESHOLD:
+ * after a seek or trick play it is stale until the audio lands */
+static int late_frame(VideoState *is, double pts, int serial)
+{
+    double diff;
+
+    if(!is->audio_st || SDL_AtomicGet(&is->trick_speed) || is->audio_serial != serial)
+        return 0;
+    diff = pts - get_audio_clock(is);
+    if(fabs(diff) >= AV_NOSYNC_THRESHOLD)
+        return 0;
+
+    if(diff >= -VIDEO_LATE_THRESHOLD)
+    {
+        is->late_in_row = 0;
+        if(++is->in_time_in_row >= VIDEO_LATE_RECOVER && is->late_level > 0)
+        {
+            set_late_level(is, is->late_level - 1);
+            is->in_time_in_row = 0;
+        }
+        return 0;
+    }
+
+    is->nb_late_dropped++;
+    is->in_time_in_row = 0;
+    if(++is->late_in_row >= VIDEO_LATE_ESCALATE && is->late_level < VIDEO_LATE_MAX_LEVEL)
+    {
+        set_late_level(is, is->late_level + 1);
+        is->late_in_row = 0;
+    }
+    return 1;
+}
+
+//the picture at pictq_windex is ready, inform video-display thread(main thread)
+static void pictq_push(VideoState *is){
+    is->pictq_windex = (is->pictq_windex + 1) % VIDEO_PICTURE_QUEUE_SIZE;
     SDL_LockMutex(is->pictq_mutex);
-    while(is->pictq_size >= 1 && !global_exit){
+    ++is->pictq_size;
+    if(is->pictq_size > is->pictq_max_size) is->pictq_max_size = is->pictq_size;
+    SDL_UnlockMutex(is->pictq_mutex);
+}
+
+static int queue_picture(VideoState *is, AVFrame *pFrame, double pts, int serial){
+    VideoPicture *vp;
+    int64_t convert_start;
+    int converted;
+
+    //wait for a free slot, the display is VIDEO_PICTURE_QUEUE_SIZE pictures behind
+    SDL_LockMutex(is->pictq_mutex);
+    if(is->pictq_size >= VIDEO_PICTURE_QUEUE_SIZE){
+        is->pictq_nb_full_waits++;
+    }
+    while(is->pictq_size >= VIDEO_PICTURE_QUEUE_SIZE && !global_exit){
         SDL_CondWait(is->pictq_cond, is->pictq_mutex);
     }
     SDL_UnlockMutex(is->pictq_mutex);
 
     if(global_exit) return -1;
 
-    //allocate space for "YUV image" on demand
-    vp = &is->pictq;
-    if(vp->allocated != 1){ //not allocated yet
+    vp = &is->pictq[is->pictq_windex];
+    vp->pts = pts;
+    vp->serial = serial;
+
+    //already what the texture takes, keep a reference to the decoder's frame instead of a copy
+    if(pFrame->format == AV_PIX_FMT_YUV420P){
+        if(!vp->frame && !(vp->frame = av_frame_alloc())){
+            return -1;
+        }
+        if(av_frame_ref(vp->frame, pFrame) < 0){
+            return -1;
+        }
+        vp->direct = 1;
+        vp->width = pFrame->width;
+        vp->height = pFrame->height;
+        is->pictq_nb_direct++;
+        pictq_push(is);
+        return 0;
+    }
+    vp->direct = 0;
+
+    //allocate space for "YUV image" on demand, at the size of the frame: the decoder may change it on the way
+    if(vp->allocated != 1 || vp->width != pFrame->width || vp->height != pFrame->height){
+        //planes with padded, aligned linesizes from the frame pool, uploaded plane by plane
         SDL_LockMutex(sdlWinMutex);
+        av_frame_free(&vp->pFrameYUV);
         vp->pFrameYUV = av_frame_alloc();
-        uint8_t *out_buffer = (uint8_t *)av_malloc(avpicture_get_size(PIX_FMT_YUV420P, is->video_ctx->width, is->video_ctx->height));
-        avpicture_fill((AVPicture *)vp->pFrameYUV, out_buffer, PIX_FMT_YUV420P, is->video_ctx->width, is->video_ctx->height);
+        if(vp->pFrameYUV){
+            vp->pFrameYUV->format = AV_PIX_FMT_YUV420P;
+            vp->pFrameYUV->width = pFrame->width;
+            vp->pFrameYUV->height = pFrame->height;
+            if(frame_pool_get_frame(is->frame_pool, vp->pFrameYUV) < 0){
+                av_frame_free(&vp->pFrameYUV);
+            }
+        }
         SDL_UnlockMutex(sdlWinMutex);
 
-        vp->width = is->video_ctx->width;
-        vp->height = is->video_ctx->height;
+        vp->width = pFrame->width;
+        vp->height = pFrame->height;
         vp->allocated = 1;
     }
 
@@ -94,16 +198,30 @@ static int queue_picture(VideoState *is, AVFrame *pFrame, double pts){
 
     //conversion: video frame --> YUV image
     if(vp->pFrameYUV){
-        vp->pts = pts;
-        sws_scale(is->sws_ctx,
-                  (const uint8_t* const *)pFrame->data, pFrame->linesize,
-                  0, is->video_ctx->height,
-                  vp->pFrameYUV->data, vp->pFrameYUV->linesize);
-
-        //inform video-display thread(main thread)
-        SDL_LockMutex(is->pictq_mutex);
-        ++is->pictq_size;
-        SDL_UnlockMutex(is->pictq_mutex);
+        convert_start = av_gettime();
+        //by the kernel of the format when it covers the frame, the size may have changed
+        converted = is->pix_convert && pFrame->format == is->pix_convert_format
+                    && pFrame->width == vp->pFrameYUV->width && pFrame->height == vp->pFrameYUV->height
+                    && is->pix_convert(pFrame, vp->pFrameYUV) >= 0;
+        //in bands across the scale threads when it can be split, in one go otherwise
+        if(!converted && sliced_scale_frame(is->sliced_scale, pFrame, vp->pFrameYUV) < 0){
+            //the decoder may change its output format on the way
+            is->sws_ctx = sws_getCachedContext(is->sws_ctx, pFrame->width, pFrame->height, pFrame->format,
+                                               vp->width, vp->height, PIX_FMT_YUV420P,
+                                               SWS_BICUBIC, NULL, NULL, NULL);
+            if(!is->sws_ctx){
+                fprintf(stderr, "sws_getCachedContext() error.\n");
+                return -1;
+            }
+            sws_scale(is->sws_ctx,
+                      (const uint8_t* const *)pFrame->data, pFrame->linesize,
+                      0, pFrame->height,
+                      vp->pFrameYUV->data, vp->pFrameYUV->linesize);
+        }
+        is->pictq_convert_time += av_gettime() - convert_start;
+        is->pictq_nb_converted++;
+
+        pictq_push(is);
     }
     return 0;
 }
@@ -111,37 +229,105 @@ static int queue_picture(VideoState *is, AVFrame *pFrame, double pts){
 int video_thread(void *arg)
 {
     VideoState *is = (VideoState *)arg;
-    AVPacket pkt1, *packet = &pkt1;
+    AVPacket packets[VIDEO_PKT_BATCH], *packet, flush_pkt;
     int frameFinished;
     AVFrame *pFrame;
-    double pts;
+    double pts, drop_until = -1, last_pts = -1;
+    int nb, i, quit = 0, trick = 0;
+    int serial = SDL_AtomicGet(&is->videoq.serial);
 
     pFrame = av_frame_alloc();
 
     for(;;)
     {
-        if(packet_queue_get(&is->videoq, packet, 1) < 0)
+        //take a burst of packets at once
+        if((nb = packet_queue_get_batch(&is->videoq, packets, VIDEO_PKT_BATCH, 1)) < 0)
             break; //means quitting getting packets
         if(global_exit)
             break;
-        pts = 0;
-
-        //decoding: packet --> frame
-        avcodec_decode_video2(is->video_ctx, pFrame, &frameFinished, packet);
-        av_free_packet(packet);
 
-        if((pts = av_frame_get_best_effort_timestamp(pFrame)) == AV_NOPTS_VALUE)
+        for(i=0; i<nb; ++i)
         {
+            packet = &packets[i];
+            //queue flushed, the rest of the batch is stale
+            if(quit || is->videoq.last_serial != SDL_AtomicGet(&is->videoq.serial))
+            {
+                av_packet_unref(packet);
+                continue;
+            }
+            //first packet after a seek: restart the decoder & drop the frames up to the target
+            if(is->videoq.last_serial != serial)
+            {
+                avcodec_flush_buffers(is->video_ctx);
+                serial = is->videoq.last_serial;
+                set_late_level(is, 0);
+                is->late_in_row = is->in_time_in_row = 0;
+                last_pts = -1;
+                trick = SDL_AtomicGet(&is->trick_speed) != 0;
+                drop_until = trick ? -1 : is->seek_target;
+                is->video_ctx->skip_frame = trick ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+            }
             pts = 0;
-        }
-        pts *= av_q2d(is->video_st->time_base);
 
-        //frame --> YUV image
-        if(frameFinished)
-        {
-            pts = synchronize_video(is, pFrame, pts);
-            if(queue_picture(is, pFrame, pts) < 0) break;
+            //decoding: packet --> frame
+            avcodec_decode_video2(is->video_ctx, pFrame, &frameFinished, packet);
+            av_packet_unref(packet);
+            if(trick)
+            {
+                //keyframes come one by one & out of order, get each out of the decoder at once
+                if(!frameFinished)
+                {
+                    av_init_packet(&flush_pkt);
+                    flush_pkt.data = NULL;
+                    flush_pkt.size = 0;
+                    avcodec_decode_video2(is->video_ctx, pFrame, &frameFinished, &flush_pkt);
+                }
+                avcodec_flush_buffers(is->video_ctx);
+            }
+
+            if((pts = av_frame_get_best_effort_timestamp(pFrame)) == AV_NOPTS_VALUE)
+            {
+                pts = 0;
+            }
+            pts *= av_q2d(is->video_st->time_base);
+
+            //frames skipped by the decoder leave a gap in the pts of the frames it outputs
+            //(the frames held back by frame threads don't)
+            if(frameFinished && !trick)
+            {
+                if(is->late_level > 0 && last_pts >= 0 && pts > last_pts)
+                    is->nb_late_skipped += FFMAX((int)((pts - last_pts) / frame_duration(is, pFrame) + 0.5) - 1, 0);
+                last_pts = pts;
+            }
+
+            //frame --> YUV image, the reference is released at the end of the loop
+            if(frameFinished)
+            {
+                startup_mark(&is->startup, STARTUP_FIRST_FRAME);
+                if(drop_until >= 0)
+                {
+                    //before the seek target: decoded as a reference only, no conversion
+                    if(pts + frame_duration(is, pFrame) <= drop_until)
+                    {
+                        av_frame_unref(pFrame);
+                        continue;
+                    }
+                    drop_until = -1;
+                    parse_seek_landed(is);
+                }
+                pts = synchronize_video(is, pFrame, pts);
+                //hopelessly late, not even converted
+                if(!trick && late_frame(is, pts, serial))
+                {
+                    av_frame_unref(pFrame);
+                    continue;
+                }
+                if(queue_picture(is, pFrame, pts, serial) < 0) quit = 1;
+            }
+            av_frame_unref(pFrame);
         }
+        if(quit)
+            break;
     }
 
     avcodec_free_frame(&pFrame);
@@ -150,17 +336,55 @@ int video_thread(void *arg)
     return 0;
 }
 
+void video_pictq_next(VideoState *is){
+    //hand the frame back to the decoder
+    if(is->pictq[is->pictq_rindex].frame){
+        av_frame_unref(is->pictq[is->pictq_rindex].frame);
+    }
+    SDL_LockMutex(is->pictq_mutex);
+    is->pictq_rindex = (is->pictq_rindex + 1) % VIDEO_PICTURE_QUEUE_SIZE;
+    --is->pictq_size;
+    SDL_CondSignal(is->pictq_cond);
+    SDL_UnlockMutex(is->pictq_mutex);
+}
+
+void video_dump_stats(VideoState *is, FILE *fp){
+    fprintf(fp, "{\"queue\":\"pictq\", \"nb_pictures\":%d, \"capacity\":%d, \"max_nb_pictures\":%d, "
+                "\"full_waits\":%d, \"empty_refreshes\":%d, "
+                "\"direct\":%d, \"converted\":%d, \"convert_us_per_frame\":%.1f, "
+                "\"presented\":%d, \"late_dropped\":%d, \"late_skipped\":%d, \"late_level\":%d}\n",
+            is->pictq_size, VIDEO_PICTURE_QUEUE_SIZE, is->pictq_max_size,
+            is->pictq_nb_full_waits, is->pictq_nb_empty,
+            is->pictq_nb_direct, is->pictq_nb_converted,
+            is->pictq_nb_converted ? (double)is->pictq_convert_time / is->pictq_nb_converted : 0.0,
+            is->nb_presented, is->nb_late_dropped, is->nb_late_skipped, is->late_level);
+}
+
 void video_display(VideoState *is){
     VideoPicture vp;
+    AVFrame *frame;
 
-    vp = is->pictq;
-    if(vp.pFrameYUV){
+    vp = is->pictq[is->pictq_rindex];
+    frame = vp.direct ? vp.frame : vp.pFrameYUV;
+    if(frame){
         SDL_LockMutex(sdlWinMutex);
 
-        SDL_UpdateTexture(sdlTex, NULL, vp.pFrameYUV->data[0], vp.pFrameYUV->linesize[0]);
+        //the frame size changed on the way, the window stays & scales the new texture
+        if(vp.width != tex_width || vp.height != tex_height){
+            SDL_DestroyTexture(sdlTex);
+            sdlTex = SDL_CreateTexture(sdlRen, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, vp.width, vp.height);
+            tex_width = vp.width;
+            tex_height = vp.height;
+        }
+
+        //each plane with its own pitch, whatever the padding of the linesizes
+        SDL_UpdateYUVTexture(sdlTex, NULL, frame->data[0], frame->linesize[0],
+                             frame->data[1], frame->linesize[1],
+                             frame->data[2], frame->linesize[2]);
         SDL_RenderClear(sdlRen);
         SDL_RenderCopy(sdlRen, sdlTex, NULL, NULL);
         SDL_RenderPresent(sdlRen);
+        is->nb_presented++;
 
         SDL_UnlockMutex(sdlWinMutex);
     }
@@ -0,0 +1,84 @@
+/** checks the planes frame_pool_get_frame() hands out: one buffer per plane, aligned data & linesizes,
+ *  each buffer at least linesize * plane height plus the over-read margin, for the formats the player
+ *  converts from or shows (YUV420P, NV12, YUV420P10) at a few sizes, odd ones included.
+ *  returns 0 when all pass.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#include <SDL.h>
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+
+#include "frame_pool.h"
+
+static const char *formats[] = {"yuv420p", "nv12", "yuv420p10le"};
+static const int sizes[][2] = {{1920, 1080}, {1280, 720}, {33, 17}, {1, 1}};
+
+static int check(FramePool *fp, const char *name, int w, int h){
+    enum AVPixelFormat format = av_get_pix_fmt(name);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    AVFrame *frame = av_frame_alloc();
+    int linesizes[4];
+    int nb_planes, i, plane_h, failed = 0;
+
+    frame->format = format;
+    frame->width = w;
+    frame->height = h;
+    if(frame_pool_get_frame(fp, frame) < 0){
+        printf("%s %dx%d: frame_pool_get_frame() failed\n", name, w, h);
+        av_frame_free(&frame);
+        return 1;
+    }
+
+    av_image_fill_linesizes(linesizes, format, w);
+    nb_planes = av_pix_fmt_count_planes(format);
+    for(i=0; i<4; ++i){
+        if(i >= nb_planes){
+            if(frame->buf[i] || frame->data[i]){
+                printf("%s %dx%d: plane %d should not exist\n", name, w, h, i);
+                failed = 1;
+            }
+            continue;
+        }
+        plane_h = (i == 1 || i == 2) ? -((-h) >> desc->log2_chroma_h) : h;
+        if(!frame->buf[i] || frame->data[i] != frame->buf[i]->data){
+            printf("%s %dx%d: plane %d has no buffer of its own\n", name, w, h, i);
+            failed = 1;
+            continue;
+        }
+        if(frame->linesize[i] < linesizes[i] || frame->linesize[i] % FRAME_POOL_ALIGN
+           || (uintptr_t)frame->data[i] % FRAME_POOL_ALIGN){
+            printf("%s %dx%d: plane %d linesize %d (%d needed) or data %p misaligned\n",
+                   name, w, h, i, frame->linesize[i], linesizes[i], frame->data[i]);
+            failed = 1;
+        }
+        if(frame->buf[i]->size < frame->linesize[i] * plane_h + 16){
+            printf("%s %dx%d: plane %d buffer of %d bytes, %d x %d rows + 16 needed\n",
+                   name, w, h, i, frame->buf[i]->size, frame->linesize[i], plane_h);
+            failed = 1;
+        }
+    }
+    if(!failed){
+        printf("%s %dx%d: ok, %d plane(s) of %d/%d/%d bytes\n", name, w, h, nb_planes,
+               frame->buf[0]->size, frame->buf[1] ? frame->buf[1]->size : 0, frame->buf[2] ? frame->buf[2]->size : 0);
+    }
+    av_frame_free(&frame);
+    return failed;
+}
+
+int main(int argc, char *argv[]){
+    FramePool *fp = frame_pool_create();
+    int i, j, failed = 0;
+
+    for(i=0; i<(int)(sizeof(formats) / sizeof(formats[0])); ++i){
+        for(j=0; j<(int)(sizeof(sizes) / sizeof(sizes[0])); ++j){
+            failed |= check(fp, formats[i], sizes[j][0], sizes[j][1]);
+            failed |= check(fp, formats[i], sizes[j][0], sizes[j][1]); //recycled from the pool this time
+        }
+    }
+    frame_pool_dump_stats(fp, stdout);
+    frame_pool_destroy(&fp);
+    printf(failed ? "FAILED\n" : "all passed\n");
+    return failed;
+}
@@ -0,0 +1,92 @@
+/** checks the allocations of PacketQueue: the slot slab once in packet_queue_init(), nothing for
+ *  refcounted packets however many times the ring wraps or the queue is cleared, one buffer for
+ *  each packet without a reference that packet_queue_put() has to copy.
+ *  returns 0 when all pass.
+ *
+ *  usage: test_packet_queue
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "packet_queue.h"
+
+static PacketQueue q;
+static int failed;
+
+static void expect(const char *what, int64_t value, int64_t expected){
+    if(value != expected){
+        printf("%s: %"PRId64", %"PRId64" expected\n", what, value, expected);
+        failed = 1;
+    }
+}
+
+static int put_refcounted(int size){
+    AVPacket pkt;
+
+    if(av_new_packet(&pkt, size) < 0){
+        return -1;
+    }
+    memset(pkt.data, 0x5A, size);
+    if(packet_queue_put(&q, &pkt) < 0){
+        av_packet_unref(&pkt);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    static uint8_t payload[100];
+    AVPacket pkt;
+    PacketQueueStats st;
+    int i;
+
+    packet_queue_init(&q);
+    packet_queue_get_stats(&q, &st);
+    expect("allocs after init", st.nb_allocs, 1);
+
+    //warm-up & steady state: the ring wraps 3 times, half full
+    for(i=0; i<3 * PACKET_QUEUE_CAPACITY; ++i){
+        if(put_refcounted(100) < 0){
+            printf("put #%d failed\n", i);
+            return 1;
+        }
+        if(i >= PACKET_QUEUE_CAPACITY / 2){
+            if(packet_queue_get(&q, &pkt, 0) != 1){
+                printf("get #%d failed\n", i);
+                return 1;
+            }
+            av_packet_unref(&pkt);
+        }
+    }
+    //a seek: the stale packets are dropped by the next get
+    packet_queue_clear(&q);
+    put_refcounted(100);
+    expect("get after clear", packet_queue_get(&q, &pkt, 0), 1);
+    expect("packets left after clear", packet_queue_nb_packets(&q), 0);
+    av_packet_unref(&pkt);
+    packet_queue_get_stats(&q, &st);
+    expect("allocs of refcounted packets", st.nb_allocs, 1);
+    expect("reuses of refcounted packets", st.nb_node_reuses, 3 * PACKET_QUEUE_CAPACITY + 1);
+    expect("copied bytes of refcounted packets", st.nb_copied_bytes, 0);
+
+    //no reference: the queue has to own a copy
+    av_init_packet(&pkt);
+    memset(payload, 0xA5, sizeof(payload));
+    pkt.data = payload;
+    pkt.size = sizeof(payload);
+    expect("put without reference", packet_queue_put(&q, &pkt), 0);
+    packet_queue_get_stats(&q, &st);
+    expect("allocs of a copied packet", st.nb_allocs, 2);
+    expect("copied bytes", st.nb_copied_bytes, sizeof(payload));
+    expect("get of the copy", packet_queue_get(&q, &pkt, 0), 1);
+    expect("copy owned by the packet", pkt.buf && pkt.data != payload && pkt.size == sizeof(payload)
+                                       && !memcmp(pkt.data, payload, sizeof(payload)), 1);
+    av_packet_unref(&pkt);
+
+    packet_queue_dump_stats(&q, "test", stdout);
+    packet_queue_destroy(&q);
+    printf(failed ? "FAILED\n" : "all passed\n");
+    return failed;
+}
@@ -0,0 +1,127 @@
+/** checks the pix_convert kernels against sws_scale(): every kernel the CPU runs (C, SSE2, AVX2)
+ *  converts random NV12, YUV422P & YUV420P10 pictures to YUV420P, the result has to be the same,
+ *  byte for byte, as the one of a same-size context: SWS_BICUBIC like the player's, SWS_AREA for
+ *  YUV422P. fixed sizes around the SIMD widths & random ones, odd ones included.
+ *  the YUV422P kernel may only decline odd heights & those under 4 rows.
+ *  returns 0 when all pass.
+ *
+ *  usage: test_pix_convert [nb_random_sizes (50)]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+#include <libswscale/swscale.h>
+#include "libavutil/pixdesc.h"
+
+#include "pix_convert.h"
+
+typedef struct Format {
+    const char *name;
+    int format; //as pix_convert_get() takes it
+    int bits; //per source sample
+    int sws_flags; //of the reference
+    int even_height; //the kernel declines the others
+} Format;
+
+static const Format formats[] = {
+    {"nv12", AV_PIX_FMT_NV12, 8, SWS_BICUBIC, 0},
+    {"yuv422p", AV_PIX_FMT_YUV422P, 8, SWS_AREA, 1},
+    {"yuv420p10le", AV_PIX_FMT_YUV420P10LE, 10, SWS_BICUBIC, 0},
+};
+static const int sizes[][2] = {{1920, 1080}, {1280, 720}, {64, 64}, {65, 33}, {33, 17}, {31, 2}, {2, 2}, {1, 1}};
+static const int isas[] = {0, PIX_CONVERT_SSE2, PIX_CONVERT_AVX2};
+static unsigned seed = 1;
+
+static AVFrame *picture(enum AVPixelFormat format, int w, int h){
+    AVFrame *frame = av_frame_alloc();
+
+    frame->format = format;
+    frame->width = w;
+    frame->height = h;
+    if(av_frame_get_buffer(frame, 32) < 0){
+        av_frame_free(&frame);
+    }
+    return frame;
+}
+
+static int check(const Format *f, int w, int h, int cpu_flags){
+    enum AVPixelFormat format = av_get_pix_fmt(f->name), yuv420p = av_get_pix_fmt("yuv420p");
+    AVFrame *src = picture(format, w, h), *ref = picture(yuv420p, w, h), *dst = picture(yuv420p, w, h);
+    struct SwsContext *sws_ctx;
+    PixConvertFunc convert;
+    const char *name;
+    int p, y, i, pw, ph, failed = 0;
+
+    convert = pix_convert_get(f->format, cpu_flags, &name);
+    if(!src || !ref || !dst || !convert){
+        printf("%s %dx%d: %s\n", f->name, w, h, convert ? "out of memory" : "no kernel");
+        failed = 1;
+        goto end;
+    }
+    //noise, 10 bits samples kept in range
+    for(p=0; p<4 && src->buf[p]; ++p){
+        for(i=0; i<src->buf[p]->size; ++i){
+            seed = seed * 1103515245 + 12345;
+            src->buf[p]->data[i] = (seed >> 16) & ((f->bits > 8 && (i & 1)) ? 0x03 : 0xFF);
+        }
+    }
+
+    if(convert(src, dst) < 0){
+        if(!f->even_height || !((h & 1) || h < 4)){
+            printf("%s %dx%d, %s: declined\n", f->name, w, h, name);
+            failed = 1;
+        }
+        goto end;
+    }
+    sws_ctx = sws_getContext(w, h, format, w, h, yuv420p, f->sws_flags, NULL, NULL, NULL);
+    sws_scale(sws_ctx, (const uint8_t * const *)src->data, src->linesize, 0, h, ref->data, ref->linesize);
+    sws_freeContext(sws_ctx);
+
+    for(p=0; p<3 && !failed; ++p){
+        pw = p ? (w + 1) >> 1 : w;
+        ph = p ? (h + 1) >> 1 : h;
+        for(y=0; y<ph; ++y){
+            if(memcmp(ref->data[p] + y * ref->linesize[p], dst->data[p] + y * dst->linesize[p], pw)){
+                printf("%s %dx%d, %s: plane %d row %d differs from sws_scale()\n", f->name, w, h, name, p, y);
+                failed = 1;
+                break;
+            }
+        }
+    }
+end:
+    av_frame_free(&src);
+    av_frame_free(&ref);
+    av_frame_free(&dst);
+    return failed;
+}
+
+int main(int argc, char *argv[]){
+    int nb_random = argc > 1 ? atoi(argv[1]) : 50;
+    int cpu_flags = pix_convert_cpu_flags();
+    int f, i, j, w, h, nb_checks = 0, failed = 0;
+
+    for(i=0; i<(int)(sizeof(isas) / sizeof(isas[0])); ++i){
+        if((cpu_flags & isas[i]) != isas[i]){
+            printf("isa %d: not supported by this CPU, skipped\n", isas[i]);
+            continue;
+        }
+        for(f=0; f<(int)(sizeof(formats) / sizeof(formats[0])); ++f){
+            for(j=0; j<(int)(sizeof(sizes) / sizeof(sizes[0])); ++j){
+                failed |= check(&formats[f], sizes[j][0], sizes[j][1], isas[i]);
+                nb_checks++;
+            }
+            for(j=0; j<nb_random; ++j){
+                seed = seed * 1103515245 + 12345;
+                w = 1 + (seed >> 16) % 1000;
+                seed = seed * 1103515245 + 12345;
+                h = 1 + (seed >> 16) % 600;
+                failed |= check(&formats[f], w, h, isas[i]);
+                nb_checks++;
+            }
+        }
+    }
+    printf(failed ? "FAILED\n" : "all %d passed\n", nb_checks);
+    return failed;
+}